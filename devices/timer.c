@@ -3,10 +3,13 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <timepage.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -24,10 +27,22 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Page mapped read-only into every user process, showing the time
+   without a system call; see timepage.h. */
+static struct time_page *time_page;
+
+/* Time-stamp counter and tick count at the first tick, to time
+   the counter across all ticks since. */
+static uint64_t tsc_base;
+static int64_t tsc_base_ticks;
+
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void time_page_update (void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -42,6 +57,9 @@ timer_init (void) {
 	outb (0x40, count & 0xff);
 	outb (0x40, count >> 8);
 
+	time_page = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_SYSTEM);
+	time_page->freq = TIMER_FREQ;
+
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -70,16 +88,23 @@ timer_calibrate (void) {
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
-/* Returns the number of timer ticks since the OS booted. */
+/* Returns the number of timer ticks since the OS booted.  Only
+   the timer interrupt changes TICKS, and an aligned 64-bit load is
+   never torn, so there is no need to disable interrupts. */
 int64_t
 timer_ticks (void) {
-	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
-	intr_set_level (old_level);
+	int64_t t = *(volatile int64_t *) &ticks;
 	barrier ();
 	return t;
 }
 
+/* Returns the kernel address of the time page, to be mapped
+   read-only into user processes at TIME_PAGE. */
+void *
+timer_time_page (void) {
+	return time_page;
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -139,6 +164,7 @@ timer_print_stats (void) {
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
 	ticks++;
+	time_page_update ();
 	thread_tick ();
 
 	if (thread_mlfqs) {
@@ -167,6 +193,34 @@ timer_interrupt (struct intr_frame *args UNUSED) {
 }
 /*************************************/
 
+/* Publishes the new tick in the time page, with the time-stamp
+   counter's rate as measured since the first tick. */
+static void
+time_page_update (void) {
+	struct time_page *tp = time_page;
+	uint64_t tsc = rdtsc ();
+
+	if (tp == NULL)
+		return;
+	if (tsc_base_ticks == 0) {
+		tsc_base = tsc;
+		tsc_base_ticks = ticks;
+	}
+
+	tp->seq++;
+	barrier ();
+	tp->ticks = ticks;
+	tp->ns = (uint64_t) ticks * NS_PER_TICK;
+	tp->tsc = tsc;
+	if (ticks > tsc_base_ticks && tsc > tsc_base) {
+		tp->cycles = (tsc - tsc_base) / (ticks - tsc_base_ticks);
+		if (tp->cycles > 0)
+			tp->mult = ((uint64_t) NS_PER_TICK << 32) / tp->cycles;
+	}
+	barrier ();
+	tp->seq++;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -11,6 +11,28 @@ static __inline void lcr3(uint64_t val) {
 	__asm __volatile("movq %0, %%cr3" : : "r" (val));
 }
 
+__attribute__((always_inline))
+static __inline uint64_t rcr4(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr4,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr4(uint64_t val) {
+	__asm __volatile("movq %0, %%cr4" : : "r" (val) : "memory");
+}
+
+/* Executes CPUID with EAX = LEAF and ECX = 0, storing the
+   resulting registers into *A, *B, *C and *D. */
+__attribute__((always_inline))
+static __inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b,
+		uint32_t *c, uint32_t *d) {
+	__asm __volatile("cpuid"
+			: "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+			: "a" (leaf), "c" (0));
+}
+
 __attribute__((always_inline))
 static __inline void lgdt(const struct desc_ptr *dtr) {
 	__asm __volatile("lgdt %0" : : "m" (*dtr));
@@ -119,6 +141,14 @@ static __inline uint64_t rcr2(void) {
 	return val;
 }
 
+/* Returns the time-stamp counter. */
+__attribute__((always_inline))
+static __inline uint64_t rdtsc(void) {
+	uint32_t lo, hi;
+	__asm __volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
 __attribute__((always_inline))
 static __inline void write_msr(uint32_t ecx, uint64_t val) {
 	uint32_t edx, eax;
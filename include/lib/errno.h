@@ -0,0 +1,16 @@
+#ifndef __LIB_ERRNO_H
+#define __LIB_ERRNO_H
+
+/* Error numbers, returned negated by kernel interfaces that
+   report why they failed, such as ring completions. */
+#define ENOENT 2                /* No such file. */
+#define EBADF 9                 /* Bad file descriptor. */
+#define ENOMEM 12               /* Out of memory. */
+#define EFAULT 14               /* Bad address. */
+#define EINVAL 22               /* Invalid argument. */
+#define EMFILE 24               /* Too many open files. */
+#define ESPIPE 29               /* Seek on a pipe. */
+#define EPIPE 32                /* Pipe has no readers. */
+#define ENAMETOOLONG 36         /* File name too long. */
+
+#endif /* lib/errno.h */
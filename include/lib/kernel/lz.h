@@ -0,0 +1,23 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fast LZ77 compression, in the style of LZ4. */
+
+/* Bits of the match finder's hash, and the size of the scratch
+   memory lz_compress() needs. */
+#define LZ_HASH_BITS 11
+#define LZ_WORK_SIZE ((1 << LZ_HASH_BITS) * sizeof (uint16_t))
+
+/* Largest input lz_compress() accepts. */
+#define LZ_MAX_INPUT 65535
+
+size_t lz_compress (const void *src, size_t src_len,
+		void *dst, size_t dst_cap, void *work);
+bool lz_decompress (const void *src, size_t src_len,
+		void *dst, size_t dst_len);
+
+#endif /* lib/kernel/lz.h */
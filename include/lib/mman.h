@@ -0,0 +1,27 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+#include <stddef.h>
+
+/* Flags for mmap_flags(). */
+#define MAP_POPULATE 0x1        /* Read the whole mapping in up front,
+                                   in large batches, instead of
+                                   faulting it in a page at a time. */
+
+/* Advice for madvise() about how a range of memory will be used. */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Accessed at random: no read-ahead. */
+#define MADV_SEQUENTIAL 2       /* Read in order, once: read far ahead,
+                                   and evict pages behind the reader. */
+#define MADV_WILLNEED 3         /* Will be used soon: bring it in now. */
+#define MADV_DONTNEED 4         /* Not needed: free it now.  Anonymous
+                                   memory reads as zeros afterward. */
+
+/* Flags for msync(). */
+#define MS_ASYNC 1              /* Leave it to background writeback. */
+#define MS_SYNC 4               /* Write back now and wait. */
+
+/* For setmemlimit(): no limit. */
+#define MEM_UNLIMITED ((size_t) -1)
+
+#endif /* lib/mman.h */
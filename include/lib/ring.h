@@ -0,0 +1,88 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+#include <stdint.h>
+
+/* Submission and completion rings, shared between a process and
+   the kernel, for queuing file operations without a system call
+   each.
+
+   A ring is one region of memory, mapped by ring_setup(): a
+   struct ring_hdr, then ENTRIES submission queue entries (SQEs),
+   then ENTRIES completion queue entries (CQEs).  ENTRIES is a
+   power of 2 and the head and tail counters run freely, so entry
+   I is at index I & (ENTRIES - 1).
+
+   The process fills in SQEs and advances SQ_TAIL; the kernel
+   consumes them, advancing SQ_HEAD.  For each, the kernel posts a
+   CQE with the SQE's USER_DATA and the result, advancing CQ_TAIL;
+   the process consumes those, advancing CQ_HEAD.  The kernel
+   stops taking SQEs while the completion ring is full.
+
+   Without RING_SQPOLL, the kernel runs queued SQEs when the
+   process calls ring_enter().  With it, a kernel thread polls the
+   ring and runs them as they appear, so submitting takes no
+   system call at all, unless the poller has gone to sleep after
+   finding nothing to do for a while: then it sets
+   RING_NEED_WAKEUP in FLAGS and ring_enter() wakes it. */
+
+/* ring_setup() flags. */
+#define RING_SQPOLL 1           /* A kernel thread polls the ring. */
+
+/* Bits in struct ring_hdr's FLAGS, set by the kernel. */
+#define RING_NEED_WAKEUP 1      /* Poller asleep: call ring_enter(). */
+
+/* Most entries in a ring. */
+#define RING_ENTRIES_MAX 256
+
+/* Operations. */
+enum ring_op
+  {
+    RING_OP_NOP,                /* Do nothing; result 0. */
+    RING_OP_READ,               /* Read LEN bytes from FD into ADDR. */
+    RING_OP_WRITE,              /* Write LEN bytes from ADDR to FD. */
+    RING_OP_OPEN,               /* Open file named at ADDR; result fd. */
+    RING_OP_CLOSE,              /* Close FD. */
+    RING_OP_FSYNC               /* Make FD's writes durable. */
+  };
+
+/* Ring header. */
+struct ring_hdr
+  {
+    uint32_t sq_head;           /* Next SQE the kernel will take. */
+    uint32_t sq_tail;           /* Next SQE the process will fill. */
+    uint32_t cq_head;           /* Next CQE the process will take. */
+    uint32_t cq_tail;           /* Next CQE the kernel will post. */
+    uint32_t entries;           /* Entries in each ring. */
+    uint32_t flags;             /* RING_NEED_WAKEUP. */
+  };
+
+/* Submission queue entry. */
+struct ring_sqe
+  {
+    uint32_t op;                /* A RING_OP_*. */
+    int32_t fd;                 /* File descriptor. */
+    uint64_t addr;              /* Buffer, or file name to open. */
+    uint32_t len;               /* Buffer size. */
+    uint32_t pad;
+    int64_t off;                /* File offset, or -1 for the position. */
+    uint64_t user_data;         /* Returned in the CQE. */
+  };
+
+/* Completion queue entry. */
+struct ring_cqe
+  {
+    uint64_t user_data;         /* From the SQE. */
+    int64_t res;                /* Result, or a negated errno.h code. */
+  };
+
+/* The SQEs and CQEs of a ring with header HDR and ENTRIES entries,
+   and its size in bytes. */
+#define RING_SQES(HDR) ((struct ring_sqe *) ((struct ring_hdr *) (HDR) + 1))
+#define RING_CQES(HDR, ENTRIES) \
+        ((struct ring_cqe *) (RING_SQES (HDR) + (ENTRIES)))
+#define RING_SIZE(ENTRIES) \
+        (sizeof (struct ring_hdr) \
+         + (ENTRIES) * (sizeof (struct ring_sqe) + sizeof (struct ring_cqe)))
+
+#endif /* lib/ring.h */
@@ -33,9 +33,23 @@ enum {
 
 	/* Extra for Project 2 */
 	SYS_DUP2,                   /* Duplicate the file descriptor */
+	SYS_PIPE,                   /* Create a pipe. */
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MADVISE,                /* Advise on use of a memory range. */
+	SYS_MSYNC,                  /* Write back a memory mapping. */
+	SYS_SETMEMLIMIT,            /* Limit the process's memory use. */
+
+	/* Benchmarking. */
+	SYS_NULL,                   /* Do nothing. */
+	SYS_TICKS,                  /* Timer ticks since boot. */
+
+	/* Submission/completion rings. */
+	SYS_RING_SETUP,             /* Map a ring. */
+	SYS_RING_ENTER,             /* Submit to and wait on a ring. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,30 @@
+#ifndef __LIB_TIMEPAGE_H
+#define __LIB_TIMEPAGE_H
+
+#include <stdint.h>
+
+/* The kernel maps one read-only page at TIME_PAGE in every user
+   process, just above the user stack (at USER_STACK), so that
+   user code can read the time without a system call.  The timer
+   interrupt rewrites the page each tick inside a sequence lock:
+   SEQ is odd while it is being written, so a reader that sees it
+   odd, or changed by the time it has read the rest, retries.
+
+   Nanoseconds since boot are NS, plus the cycles since TSC, at
+   most CYCLES - 1 of them, times MULT / 2^32.  Until the kernel
+   has timed the time-stamp counter across a tick, MULT is 0 and
+   the clock only advances a tick at a time. */
+#define TIME_PAGE ((void *) 0x47480000)
+
+struct time_page
+  {
+    uint32_t seq;               /* Odd while the page is being written. */
+    int64_t ticks;              /* Timer ticks since boot. */
+    int64_t freq;               /* Timer ticks per second. */
+    uint64_t ns;                /* Nanoseconds since boot at the last tick. */
+    uint64_t tsc;               /* Time-stamp counter at the last tick. */
+    uint64_t cycles;            /* Time-stamp counter cycles per tick. */
+    uint64_t mult;              /* Nanoseconds per cycle, times 2^32. */
+  };
+
+#endif /* lib/timepage.h */
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <mman.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -37,10 +39,24 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+int pipe (int fds[2]);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
+void *mmap_flags (void *addr, size_t length, int writable, int fd,
+		off_t offset, int flags);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int msync (void *addr, size_t length, int flags);
+int setmemlimit (size_t resident, size_t swap);
+
+/* Benchmarking. */
+int null_syscall (void);
+int64_t ticks (void);
+
+/* Submission/completion rings; see ring.h and uring.h. */
+int ring_setup (void *addr, unsigned entries, int flags);
+int ring_enter (int ring, unsigned to_submit, unsigned min_complete);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -0,0 +1,21 @@
+#ifndef __LIB_USER_TIME_H
+#define __LIB_USER_TIME_H
+
+#include <stdint.h>
+
+/* A time, in seconds and nanoseconds. */
+struct timespec
+  {
+    int64_t tv_sec;             /* Seconds. */
+    long tv_nsec;               /* Nanoseconds, 0 to 999,999,999. */
+  };
+
+/* Clocks for clock_gettime(). */
+#define CLOCK_MONOTONIC 1       /* Time since boot. */
+
+/* These read the kernel's time page, without a system call. */
+int64_t clock_ticks (void);
+uint64_t clock_ns (void);
+int clock_gettime (int clock, struct timespec *ts);
+
+#endif /* lib/user/time.h */
@@ -0,0 +1,29 @@
+#ifndef __LIB_USER_URING_H
+#define __LIB_USER_URING_H
+
+#include <ring.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A process's view of a submission/completion ring.  See ring.h. */
+struct uring
+  {
+    int id;                     /* Identifier from ring_setup(). */
+    int flags;                  /* ring_setup() flags. */
+    unsigned entries;           /* Entries in each ring. */
+    struct ring_hdr *hdr;       /* Ring memory. */
+    struct ring_sqe *sqes;
+    struct ring_cqe *cqes;
+    uint32_t sq_tail;           /* Next SQE to hand out. */
+    uint32_t sq_submitted;      /* SQ_TAIL at the last submission. */
+  };
+
+bool uring_init (struct uring *, void *addr, unsigned entries, int flags);
+struct ring_sqe *uring_get_sqe (struct uring *);
+void uring_prep_rw (struct ring_sqe *, int op, int fd, void *buf,
+                    unsigned len, int64_t off, uint64_t user_data);
+int uring_submit (struct uring *);
+bool uring_peek (struct uring *, struct ring_cqe *);
+void uring_wait (struct uring *, struct ring_cqe *);
+
+#endif /* lib/user/uring.h */
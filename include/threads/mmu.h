@@ -2,19 +2,49 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
+/* Most pages a TLB gather flushes one at a time.  Past this, the
+ * whole TLB of the page map is flushed instead. */
+#define TLB_GATHER_MAX 32
+
+/* Pages unmapped from one page map whose TLB entries have yet to
+ * be flushed.  See tlb_gather_init(). */
+struct tlb_gather {
+	uint64_t *pml4;                 /* Page map, or NULL if none yet. */
+	size_t cnt;                     /* Pages pending flush. */
+	uint64_t va[TLB_GATHER_MAX];    /* Their addresses, if few enough. */
+	unsigned page_cnt;              /* Pages gathered in all. */
+	unsigned flush_cnt;             /* Flushes done in all. */
+};
+
+/* Use PCIDs if the CPU has them?  Cleared by -no-pcid. */
+extern bool tlb_use_pcid;
+
+/* Map user memory with 2 MiB pages where it can be?  Cleared by
+ * -no-large. */
+extern bool large_pages;
+
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
+uint64_t *pml4_pde_walk (uint64_t *pml4, const uint64_t va, int create);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
+void tlb_init (void);
+void tlb_print_stats (void);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_large_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
 void pml4_clear_page (uint64_t *pml4, void *upage);
+void pml4_clear_page_gather (uint64_t *pml4, void *upage,
+		struct tlb_gather *tlb);
+void tlb_gather_init (struct tlb_gather *tlb);
+void tlb_gather_flush (struct tlb_gather *tlb);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed (uint64_t *pml4, const void *upage);
@@ -23,6 +53,7 @@ void pml4_set_accessed (uint64_t *pml4, const void *upage, bool accessed);
 #define is_writable(pte) (*(pte) & PTE_W)
 #define is_user_pte(pte) (*(pte) & PTE_U)
 #define is_kern_pte(pte) (!is_user_pte (pte))
+#define is_large_pte(pte) (*(pte) & PTE_PS)
 
 #define pte_get_paddr(pte) (pg_round_down(*(pte)))
 
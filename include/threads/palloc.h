@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -8,16 +9,40 @@
 enum palloc_flags {
 	PAL_ASSERT = 001,           /* Panic on failure. */
 	PAL_ZERO = 002,             /* Zero page contents. */
-	PAL_USER = 004              /* User page. */
+	PAL_USER = 004,             /* User page. */
+
+	/* Owner of kernel pages, for accounting only.  Pages with none
+	   of these flags are counted as "other". */
+	PAL_THREAD = 010,           /* Thread structure and kernel stack. */
+	PAL_PGTABLE = 020,          /* Page map or page table. */
+	PAL_MALLOC = 040,           /* malloc() arena. */
+	PAL_PROCESS = 0100,         /* Process bookkeeping, e.g. exec args. */
+	PAL_FILESYS = 0200,         /* File system buffers and caches. */
+	PAL_VM = 0400,              /* Virtual memory bookkeeping. */
+	PAL_SYSTEM = 01000          /* Kernel data kept until shutdown. */
 };
 
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* Minimum number of pages kept for kernel and for user pages. */
+extern size_t kernel_page_reserve;
+extern size_t user_page_reserve;
+
+/* Reclaim hook.  Called when a request made with FLAGS for
+   PAGE_CNT pages cannot be satisfied; should free up to PAGE_CNT
+   pages and return the number actually freed. */
+typedef size_t palloc_reclaim_func (enum palloc_flags flags, size_t page_cnt);
+
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_large (enum palloc_flags);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_zero_idle (void);
+void palloc_print_stats (void);
+void palloc_register_reclaim (palloc_reclaim_func *);
+size_t palloc_free_pages (enum palloc_flags);
 
 #endif /* threads/palloc.h */
@@ -41,5 +41,14 @@
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=2 MiB page (PDEs only). */
+#define PTE_G 0x100                      /* 1=global, kept across CR3 loads. */
+
+/* A page directory entry with PTE_PS set maps a 2 MiB "large
+   page" directly, without a page table below it.  Its accessed
+   and dirty bits are in the same place as in a PTE. */
+#define LARGE_PGSIZE (1UL << PDXSHIFT)   /* Bytes in a large page. */
+#define LARGE_PGCNT (LARGE_PGSIZE / PGSIZE) /* Pages in a large page. */
+#define large_pg_ofs(va) ((uint64_t) (va) & (LARGE_PGSIZE - 1))
 
 #endif /* threads/pte.h */
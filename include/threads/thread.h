@@ -110,6 +110,13 @@ struct thread {
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+	struct fd_entry *fd_table;          /* Open descriptors, or NULL. */
+	struct list rings;                  /* Submission/completion rings. */
+	struct file *exec_file;             /* Running executable, kept open. */
+	struct child *child;                /* Record shared with the parent. */
+	struct list children;               /* Records of unwaited children. */
+	int exit_status;                    /* Reported to the parent. */
+	struct intr_frame *user_if;         /* User context during a syscall. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
@@ -144,6 +151,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_sleep (int64_t ticks);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
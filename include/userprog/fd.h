@@ -0,0 +1,35 @@
+#ifndef USERPROG_FD_H
+#define USERPROG_FD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* File descriptors 0 and 1 are the console; files and pipes get
+ * the rest. */
+#define FD_FIRST 2
+#define FD_MAX 512
+
+/* Longest file name accepted, not counting the null. */
+#define FD_NAME_MAX 63
+
+/* Serializes all file system calls made for user processes. */
+extern struct lock filesys_lock;
+
+void fd_init (void);
+int fd_open (struct thread *t, const char *name);
+int fd_pipe (struct thread *t, int fds[2]);
+int fd_close (struct thread *t, int fd);
+void fd_close_all (struct thread *t);
+bool fd_copy_all (struct thread *child, struct thread *parent);
+bool fd_valid (struct thread *t, int fd);
+struct file *fd_reopen (struct thread *t, int fd);
+long fd_io (struct thread *t, int fd, void *ubuf, size_t size, off_t ofs,
+		bool write);
+long fd_filesize (struct thread *t, int fd);
+int fd_seek (struct thread *t, int fd, off_t pos);
+long fd_tell (struct thread *t, int fd);
+
+#endif /* userprog/fd.h */
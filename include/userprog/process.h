@@ -1,8 +1,19 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include "threads/synch.h"
 #include "threads/thread.h"
 
+/* What a parent knows of one of its child processes.  Shared by
+ * the two and freed when both have let go of it. */
+struct child {
+	tid_t tid;                  /* The child's thread. */
+	int exit_status;            /* Set when it exits. */
+	struct semaphore exited;    /* Upped when it exits. */
+	int ref_cnt;                /* Holders left: parent, child. */
+	struct list_elem elem;      /* In the parent's CHILDREN. */
+};
+
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
@@ -0,0 +1,16 @@
+#ifndef USERPROG_RING_H
+#define USERPROG_RING_H
+
+#include <stddef.h>
+#include "threads/thread.h"
+
+/* Ticks the ring poller spins without finding work before it
+   sleeps. */
+extern int64_t ring_idle;
+
+int ring_setup (void *addr, unsigned entries, int flags);
+int ring_enter (int id, unsigned to_submit, unsigned min_complete);
+void ring_destroy_all (struct thread *t);
+void ring_print_stats (void);
+
+#endif /* userprog/ring.h */
@@ -0,0 +1,13 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+int copy_from_user (void *dst, const void *usrc, size_t size);
+int copy_to_user (void *udst, const void *src, size_t size);
+long strncpy_from_user (char *dst, const char *usrc, size_t size);
+uintptr_t uaccess_fixup (uintptr_t rip);
+
+#endif /* userprog/uaccess.h */
@@ -5,9 +5,14 @@ struct page;
 enum vm_type;
 
 struct anon_page {
+	size_t slot;            /* Swap slot holding the page, if evicted. */
 };
 
 void vm_anon_init (void);
+void vm_anon_print_stats (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_share_slot (struct page *dst, struct page *src);
+void anon_discard (struct page *page);
+uint64_t anon_checksum (const void *kva);
 
 #endif
@@ -7,11 +7,38 @@ struct page;
 enum vm_type;
 
 struct file_page {
+	struct file *file;      /* Private handle to the backing file. */
+	off_t ofs;              /* Offset of the page in FILE. */
+	size_t read_bytes;      /* Bytes backed by FILE; the rest is zero. */
+};
+
+/* Where to read a lazily loaded page's contents from: READ_BYTES
+ * bytes of FILE at OFS, the rest of the page zeroed.  FILE is a
+ * private reopened handle, closed by file_load_free(). */
+struct file_load {
+	struct file *file;
+	off_t ofs;
+	size_t read_bytes;
+};
+
+/* A memory-mapped file: PAGE_CNT pages from ADDR, each backed by
+ * its own handle to the file. */
+struct mmap_region {
+	void *addr;
+	size_t page_cnt;
+	struct list_elem elem;  /* In supplemental_page_table's MMAPS. */
 };
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
-void *do_mmap(void *addr, size_t length, int writable,
+void *do_mmap(void *addr, size_t length, int writable, int flags,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+bool mmap_regions_copy (struct list *dst, struct list *src);
+void mmap_regions_free (struct list *);
+
+struct file_load *file_load_new (struct file *, off_t ofs, size_t read_bytes);
+struct file_load *file_load_dup (const struct file_load *);
+void file_load_free (struct file_load *);
+bool file_load_read (const struct file_load *, void *kva);
 #endif
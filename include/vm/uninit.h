@@ -8,7 +8,14 @@ enum vm_type;
 typedef bool vm_initializer (struct page *, void *aux);
 
 /* Uninitlialized page. The type for implementing the
- * "Lazy loading". */
+ * "Lazy loading".
+ *
+ * AUX is either NULL or a struct file_load that the page owns:
+ * the initializer consumes it, uninit_destroy() frees it if the
+ * page is never touched, and supplemental_page_table_copy()
+ * duplicates it for the child.  An anonymous page with no INIT
+ * is zero-filled on first touch; a file-backed page has no INIT
+ * and is read by file_backed_initializer() from its AUX. */
 struct uninit_page {
 	/* Initiate the contets of the page */
 	vm_initializer *init;
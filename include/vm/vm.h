@@ -1,6 +1,10 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <hash.h>
+#include <list.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -36,6 +40,9 @@ struct thread;
 
 #define VM_TYPE(type) ((type) & 7)
 
+/* Marks a page of the user stack. */
+#define VM_STACK VM_MARKER_0
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -45,7 +52,11 @@ struct page {
 	void *va;              /* Address in terms of user space */
 	struct frame *frame;   /* Back reference for frame */
 
-	/* Your implementation */
+	bool writable;         /* Writable by the user process? */
+	uint64_t *pml4;        /* Page map the page is installed in. */
+	struct supplemental_page_table *spt;  /* Table the page is in. */
+	int advice;            /* MADV_* hint from madvise(). */
+	struct list_elem frame_elem;  /* Element in frame's PAGES. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -59,10 +70,31 @@ struct page {
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".  Every frame holding a user
+ * page is on the frame table, in the order the clock hand visits
+ * them.  After fork, several pages may share one frame copy-on-
+ * write; each is mapped read-only until it is the last one.  A
+ * frame holding read-only program text is also in the text table
+ * under the file position it was read from, and is shared by
+ * every process that maps that position read-only.  A frame of
+ * anonymous memory whose contents have stopped changing may be in
+ * the same-page merging table, where other frames found to hold
+ * the same contents are merged into it copy-on-write. */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct list pages;      /* Pages using this frame. */
+	unsigned ref_cnt;       /* Number of pages in PAGES. */
+	struct list_elem elem;  /* Frame table element. */
+	bool prefetched;        /* Brought in ahead of a fault, not yet used? */
+	bool busy;              /* Pinned for I/O without FRAME_LOCK? */
+
+	struct inode *inode;    /* Text read from INODE, or null. */
+	off_t ofs;              /* ...at this offset. */
+	struct hash_elem text_elem;  /* Text table element. */
+
+	uint64_t ksm_sum;       /* Checksum at the last merging scan. */
+	bool ksm_listed;        /* In the merging table? */
+	struct hash_elem ksm_elem;   /* Merging table element. */
 };
 
 /* The function table for page operations.
@@ -81,12 +113,71 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* Stride prefetcher: history of a process's recent major faults,
+ * and the streams of equally spaced faults found in it. */
+#define PF_HISTORY 8
+#define PF_STREAMS 4
+
+/* A stream of faults STRIDE pages apart.  Pages up to NEXT, not
+ * included, have been prefetched; a fault on NEXT continues the
+ * stream. */
+struct pf_stream {
+	uint64_t next;         /* Page number of the next page to fetch. */
+	int64_t stride;        /* Distance in pages, or 0 if unused. */
+};
+
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ *
+ * A radix tree laid out like the x86-64 page table: four levels
+ * of page-sized nodes, each an array of 512 pointers indexed by
+ * the PML4, PDPE, PDX and PTX fields of the user virtual address.
+ * A lookup is four dependent loads and never rehashes, and range
+ * walks skip whole empty subtrees.  Interior nodes are freed only
+ * when the table is killed.
+ *
+ * The table also tracks the process's resident set: the frames
+ * its pages use, against a target that its page fault frequency
+ * controller raises while it faults often and lowers while it
+ * faults rarely.  Eviction takes frames from processes above
+ * their target first.  The resident set fields are updated with
+ * interrupts off.
+ *
+ * A process may also be limited in the frames and swap slots it
+ * holds.  Once at its frame limit, it evicts its own pages to
+ * make room for new ones, and once at its swap limit, its
+ * anonymous pages are no longer evicted at all.  Limits are
+ * inherited across fork and kept across exec.
+ *
+ * Finally, the table holds the state of the process's stride
+ * prefetcher; see vm.c. */
 struct supplemental_page_table {
+	void **root;           /* Top-level node, or NULL if empty. */
+	size_t page_cnt;       /* Number of pages in the table. */
+	struct list mmaps;     /* Memory-mapped files, as mmap_regions. */
+
+	size_t resident;       /* Pages holding a frame of their own. */
+	size_t resident_peak;  /* ...at most. */
+	size_t target;         /* Frames the process should hold. */
+	bool over;             /* RESIDENT > TARGET? */
+	int64_t pff_start;     /* Tick the current fault window began. */
+	unsigned pff_faults;   /* Major faults in the window so far. */
+	unsigned pff_rate;     /* Major faults per second, last window. */
+
+	size_t rss_limit;      /* Most frames to hold, or SIZE_MAX. */
+	size_t swap_limit;     /* Most swap slots to hold, or SIZE_MAX. */
+	size_t swap_used;      /* Swap slots held, counting shared ones. */
+
+	uint64_t pf_history[PF_HISTORY];  /* Recent major fault pages. */
+	unsigned pf_head;                 /* Next entry to replace. */
+	struct pf_stream pf_streams[PF_STREAMS];
+	unsigned pf_stream_next;          /* Next stream to replace. */
+	unsigned pf_window;               /* Pages to prefetch per fault. */
 };
 
+/* Called by spt_for_each() for each page in a range.  Returning
+ * false stops the walk. */
+typedef bool spt_action_func (struct page *page, void *aux);
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
@@ -96,8 +187,37 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+bool spt_for_each (struct supplemental_page_table *spt, void *start,
+		void *end, spt_action_func *action, void *aux);
+
+/* Radix tree internals, in spt.c. */
+void **spt_slot (struct supplemental_page_table *spt, const void *va,
+		bool create);
+void spt_free_nodes (struct supplemental_page_table *spt);
+
+/* Size of the fault-around window, in pages. */
+extern size_t fault_around_pages;
+
+/* Free user frame watermarks for page reclaim. */
+extern size_t wmark_min, wmark_low, wmark_high;
+
+/* Ticks between background writeback passes, or 0 for none. */
+extern int64_t writeback_interval;
+
+/* Print each process's resident set figures when it exits? */
+extern bool rss_report;
+
+/* Frame and swap limits for processes the kernel starts. */
+extern size_t rss_limit_default, swap_limit_default;
+
+/* Same-page merging: frames scanned per pass, or 0 for none, and
+ * ticks between passes. */
+extern size_t ksm_pages;
+extern int64_t ksm_sleep;
 
 void vm_init (void);
+void vm_print_stats (void);
+void vm_fault_counts (long long *major, long long *minor);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -107,6 +227,14 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_prefetch_page (struct page *page);
+void vm_populate (void *start, void *end, bool may_evict);
+bool vm_madvise (void *addr, size_t length, int advice);
+bool vm_msync (void *addr, size_t length, int flags);
+void vm_release_frame (struct page *page);
+void vm_unmap_range (void *start, void *end);
+bool vm_set_limits (size_t resident, size_t swap);
+void vm_swap_charge (struct page *page, int delta);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
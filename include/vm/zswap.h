@@ -0,0 +1,19 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Writes the page at KVA to swap slot SLOT on disk. */
+typedef void zswap_writeback_func (size_t slot, const void *kva);
+
+/* Share of kernel memory the compressed pool may use, in percent.
+ * Set with -zswap=PERCENT; 0 turns the pool off. */
+extern unsigned zswap_percent;
+
+void zswap_init (size_t slot_cnt, zswap_writeback_func *writeback);
+bool zswap_store (size_t slot, const void *kva);
+bool zswap_load (size_t slot, void *kva);
+void zswap_invalidate (size_t slot);
+void zswap_print_stats (void);
+
+#endif
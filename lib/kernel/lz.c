@@ -0,0 +1,184 @@
+#include "lz.h"
+#include <debug.h>
+#include <string.h>
+
+/* Fast LZ77 compression, in the style of LZ4.
+
+   The compressed form is a series of sequences.  Each starts
+   with a token byte whose high nibble is a count of literal bytes
+   and whose low nibble is a match length less LZ_MIN_MATCH.  A
+   nibble of 15 means the count continues in the following bytes,
+   each added to it, up to and including the first byte that is
+   not 255.  Then come the literal bytes, then a 2-byte
+   little-endian offset back into the output at which the match
+   starts.  The last sequence has only literals and ends the
+   input.
+
+   The compressor is greedy: it looks up each 4-byte string of the
+   input in a hash table of the last place it was seen, and takes
+   any match it finds there as far as it goes.  That finds less
+   than a search would, but runs at a few cycles per byte. */
+
+/* Shortest match worth encoding. */
+#define LZ_MIN_MATCH 4
+
+/* Returns the 4 bytes at P, in host order. */
+static inline uint32_t
+read32 (const uint8_t *p) {
+	uint32_t v;
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+/* Returns the hash table bucket for 4 bytes V. */
+static inline size_t
+hash4 (uint32_t v) {
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes the continuation bytes for count N, which had 15
+   subtracted from it in the token.  Returns the new output
+   position. */
+static uint8_t *
+put_count (uint8_t *op, size_t n) {
+	for (; n >= 255; n -= 255)
+		*op++ = 255;
+	*op++ = n;
+	return op;
+}
+
+/* Writes a sequence of LIT_CNT literals from LIT followed, unless
+   MATCH_LEN is 0, by a match of MATCH_LEN bytes at OFFSET back,
+   into OP, which may not pass OEND.  Returns the new output
+   position, or a null pointer if it would not fit. */
+static uint8_t *
+put_sequence (uint8_t *op, uint8_t *oend, const uint8_t *lit,
+		size_t lit_cnt, size_t offset, size_t match_len) {
+	size_t m = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+	size_t need = 1 + lit_cnt / 255 + 1 + lit_cnt + 2 + m / 255 + 1;
+	uint8_t *token;
+
+	if ((size_t) (oend - op) < need)
+		return NULL;
+
+	token = op++;
+	*token = (lit_cnt < 15 ? lit_cnt : 15) << 4;
+	if (lit_cnt >= 15)
+		op = put_count (op, lit_cnt - 15);
+	memcpy (op, lit, lit_cnt);
+	op += lit_cnt;
+	if (match_len == 0)
+		return op;
+
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+	*token |= m < 15 ? m : 15;
+	if (m >= 15)
+		op = put_count (op, m - 15);
+	return op;
+}
+
+/* Compresses the SRC_LEN bytes at SRC into DST, which has room
+   for DST_CAP bytes, using the LZ_WORK_SIZE bytes at WORK as
+   scratch space.  Returns the compressed size, or 0 if it would
+   be more than DST_CAP. */
+size_t
+lz_compress (const void *src_, size_t src_len, void *dst_, size_t dst_cap,
+		void *work) {
+	const uint8_t *src = src_;
+	const uint8_t *end = src + src_len;
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	uint8_t *op = dst_;
+	uint8_t *oend = op + dst_cap;
+	uint16_t *table = work;
+
+	ASSERT (src_len <= LZ_MAX_INPUT);
+
+	memset (table, 0, LZ_WORK_SIZE);
+	while (src_len >= LZ_MIN_MATCH && ip <= end - LZ_MIN_MATCH) {
+		uint32_t v = read32 (ip);
+		size_t h = hash4 (v);
+		const uint8_t *ref = src + table[h];
+		const uint8_t *mp, *rp;
+
+		table[h] = ip - src;
+		if (ref >= ip || read32 (ref) != v) {
+			ip++;
+			continue;
+		}
+
+		for (mp = ip + LZ_MIN_MATCH, rp = ref + LZ_MIN_MATCH;
+				mp < end && *mp == *rp; mp++, rp++)
+			continue;
+		op = put_sequence (op, oend, anchor, ip - anchor, ip - ref, mp - ip);
+		if (op == NULL)
+			return 0;
+		ip = anchor = mp;
+	}
+
+	op = put_sequence (op, oend, anchor, end - anchor, 0, 0);
+	return op != NULL ? (size_t) (op - (uint8_t *) dst_) : 0;
+}
+
+/* Reads a count continued after a token nibble of 15 from *IP,
+   which may not pass IEND, adding it to *N.  Returns false if the
+   input ends first. */
+static bool
+get_count (const uint8_t **ip, const uint8_t *iend, size_t *n) {
+	uint8_t b;
+
+	do {
+		if (*ip >= iend)
+			return false;
+		b = *(*ip)++;
+		*n += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses the SRC_LEN bytes at SRC, produced by
+   lz_compress(), into the DST_LEN bytes at DST.  Returns true if
+   successful, false if the input is malformed or does not
+   decompress to exactly DST_LEN bytes. */
+bool
+lz_decompress (const void *src, size_t src_len, void *dst_, size_t dst_len) {
+	const uint8_t *ip = src;
+	const uint8_t *iend = ip + src_len;
+	uint8_t *dst = dst_;
+	uint8_t *op = dst;
+	uint8_t *oend = dst + dst_len;
+
+	while (ip < iend) {
+		unsigned token = *ip++;
+		size_t lit_cnt = token >> 4;
+		size_t match_len = token & 15;
+		size_t offset;
+
+		if (lit_cnt == 15 && !get_count (&ip, iend, &lit_cnt))
+			return false;
+		if ((size_t) (iend - ip) < lit_cnt || (size_t) (oend - op) < lit_cnt)
+			return false;
+		memcpy (op, ip, lit_cnt);
+		op += lit_cnt;
+		ip += lit_cnt;
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (match_len == 15 && !get_count (&ip, iend, &match_len))
+			return false;
+		match_len += LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t) (op - dst)
+				|| (size_t) (oend - op) < match_len)
+			return false;
+
+		/* Byte by byte: the match may overlap what it copies. */
+		for (; match_len > 0; match_len--, op++)
+			*op = op[-offset];
+	}
+	return op == oend;
+}
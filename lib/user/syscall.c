@@ -68,6 +68,15 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG3), \
 			((uint64_t) ARG4), \
 			0))
+
+#define syscall6(NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4, ARG5) ( \
+		syscall(((uint64_t) NUMBER), \
+			((uint64_t) ARG0), \
+			((uint64_t) ARG1), \
+			((uint64_t) ARG2), \
+			((uint64_t) ARG3), \
+			((uint64_t) ARG4), \
+			((uint64_t) ARG5)))
 void
 halt (void) {
 	syscall0 (SYS_HALT);
@@ -145,9 +154,21 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
-	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
+	return mmap_flags (addr, length, writable, fd, offset, 0);
+}
+
+void *
+mmap_flags (void *addr, size_t length, int writable, int fd, off_t offset,
+		int flags) {
+	return (void *) syscall6 (SYS_MMAP, addr, length, writable, fd, offset,
+			flags);
 }
 
 void
@@ -155,6 +176,41 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+msync (void *addr, size_t length, int flags) {
+	return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+int
+setmemlimit (size_t resident, size_t swap) {
+	return syscall2 (SYS_SETMEMLIMIT, resident, swap);
+}
+
+int
+null_syscall (void) {
+	return syscall0 (SYS_NULL);
+}
+
+int64_t
+ticks (void) {
+	return syscall0 (SYS_TICKS);
+}
+
+int
+ring_setup (void *addr, unsigned entries, int flags) {
+	return syscall3 (SYS_RING_SETUP, addr, entries, flags);
+}
+
+int
+ring_enter (int ring, unsigned to_submit, unsigned min_complete) {
+	return syscall3 (SYS_RING_ENTER, ring, to_submit, min_complete);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -0,0 +1,75 @@
+#include <time.h>
+#include <timepage.h>
+
+/* The kernel's time page.  See timepage.h. */
+static volatile const struct time_page *const tp = TIME_PAGE;
+
+/* Optimization barrier: keeps the compiler from moving loads of
+   the time page across it.  The CPU does not reorder loads with
+   other loads, so this is all a seqlock reader needs. */
+#define barrier() asm volatile ("" : : : "memory")
+
+static inline uint64_t
+rdtsc (void) {
+	uint32_t lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* Reads a consistent snapshot of the time page into *SNAP. */
+static void
+read_page (struct time_page *snap) {
+	uint32_t seq;
+
+	do {
+		seq = tp->seq;
+		barrier ();
+		snap->ticks = tp->ticks;
+		snap->freq = tp->freq;
+		snap->ns = tp->ns;
+		snap->tsc = tp->tsc;
+		snap->cycles = tp->cycles;
+		snap->mult = tp->mult;
+		barrier ();
+	} while ((seq & 1) != 0 || seq != tp->seq);
+}
+
+/* Returns the number of timer ticks since boot. */
+int64_t
+clock_ticks (void) {
+	struct time_page snap;
+
+	read_page (&snap);
+	return snap.ticks;
+}
+
+/* Returns the number of nanoseconds since boot.  Between ticks,
+   the time is interpolated with the time-stamp counter, and never
+   reaches the next tick's time. */
+uint64_t
+clock_ns (void) {
+	struct time_page snap;
+	uint64_t cycles;
+
+	read_page (&snap);
+	if (snap.mult == 0)
+		return snap.ns;
+	cycles = rdtsc () - snap.tsc;
+	if (cycles >= snap.cycles)
+		cycles = snap.cycles - 1;
+	return snap.ns + ((cycles * snap.mult) >> 32);
+}
+
+/* Stores the time of CLOCK in *TS.  Returns 0 if successful, -1
+   if CLOCK is not a supported clock. */
+int
+clock_gettime (int clock, struct timespec *ts) {
+	uint64_t ns;
+
+	if (clock != CLOCK_MONOTONIC)
+		return -1;
+	ns = clock_ns ();
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+	return 0;
+}
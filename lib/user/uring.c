@@ -0,0 +1,98 @@
+#include <uring.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Optimization barrier: the kernel runs on the same CPU, which
+   keeps stores in order with stores and loads with loads, so
+   only the compiler has to be kept from reordering. */
+#define barrier() asm volatile ("" : : : "memory")
+
+/* Sets up RING with ENTRIES entries at ADDR, a page-aligned
+   address with room for RING_SIZE (ENTRIES) bytes of unused
+   address space.  FLAGS is as for ring_setup().  Returns true if
+   successful. */
+bool
+uring_init (struct uring *ring, void *addr, unsigned entries, int flags) {
+	int id = ring_setup (addr, entries, flags);
+
+	if (id < 0)
+		return false;
+	ring->id = id;
+	ring->flags = flags;
+	ring->entries = entries;
+	ring->hdr = addr;
+	ring->sqes = RING_SQES (addr);
+	ring->cqes = RING_CQES (addr, entries);
+	ring->sq_tail = ring->sq_submitted = 0;
+	return true;
+}
+
+/* Returns the next free SQE of RING, to be filled in and then
+   submitted by uring_submit(), or a null pointer if the
+   submission ring is full. */
+struct ring_sqe *
+uring_get_sqe (struct uring *ring) {
+	struct ring_sqe *sqe;
+
+	if (ring->sq_tail - *(volatile uint32_t *) &ring->hdr->sq_head
+			>= ring->entries)
+		return NULL;
+	sqe = &ring->sqes[ring->sq_tail++ & (ring->entries - 1)];
+	memset (sqe, 0, sizeof *sqe);
+	return sqe;
+}
+
+/* Fills in SQE for operation OP on FD with buffer BUF of LEN
+   bytes at file offset OFF, or at the file position if OFF is
+   -1. */
+void
+uring_prep_rw (struct ring_sqe *sqe, int op, int fd, void *buf,
+               unsigned len, int64_t off, uint64_t user_data) {
+	sqe->op = op;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t) buf;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->user_data = user_data;
+}
+
+/* Submits the SQEs filled in since the last call.  Makes a system
+   call only if RING is not polled or its poller is asleep.
+   Returns the number of SQEs submitted. */
+int
+uring_submit (struct uring *ring) {
+	int cnt = ring->sq_tail - ring->sq_submitted;
+
+	barrier ();
+	ring->hdr->sq_tail = ring->sq_tail;
+	ring->sq_submitted = ring->sq_tail;
+	barrier ();
+	if (!(ring->flags & RING_SQPOLL))
+		return ring_enter (ring->id, cnt, 0);
+	if (*(volatile uint32_t *) &ring->hdr->flags & RING_NEED_WAKEUP)
+		ring_enter (ring->id, 0, 0);
+	return cnt;
+}
+
+/* Takes the next completion from RING into *CQE and returns true,
+   or returns false if there is none yet. */
+bool
+uring_peek (struct uring *ring, struct ring_cqe *cqe) {
+	uint32_t head = ring->hdr->cq_head;
+
+	if (head == *(volatile uint32_t *) &ring->hdr->cq_tail)
+		return false;
+	barrier ();
+	*cqe = ring->cqes[head & (ring->entries - 1)];
+	barrier ();
+	ring->hdr->cq_head = head + 1;
+	return true;
+}
+
+/* Waits for the next completion from RING and takes it into
+   *CQE.  There must be an operation outstanding. */
+void
+uring_wait (struct uring *ring, struct ring_cqe *cqe) {
+	while (!uring_peek (ring, cqe))
+		ring_enter (ring->id, 0, 1);
+}
@@ -38,6 +38,11 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+#ifdef VM
+    {"spt-bench", test_spt_bench},
+    {"lz-page", test_lz_page},
+    {"uaccess-bench", test_uaccess_bench},
+#endif
   };
 
 static const char *test_name;
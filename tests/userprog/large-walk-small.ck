@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing begin message\n"
+  unless grep ($_ eq '(large-walk-small) begin', @output);
+for my $walk (0...3) {
+    fail "missing timing for walk $walk\n"
+      unless grep (/^\(large-walk-small\) walk $walk: 64 MiB in \d+ cycles$/,
+		   @output);
+}
+fail "missing end message\n"
+  unless grep ($_ eq '(large-walk-small) end', @output);
+
+pass;
@@ -0,0 +1,42 @@
+/* Walks a 64 MiB array a few times, touching one byte in every
+   page, and reports how long each walk took.  The array lives in
+   BSS, which the loader, or under VM the first write fault, can
+   map with 2 MiB pages.  large-walk-small runs the same walks
+   with -no-large, so the two show the cost of TLB misses with and
+   without large pages. */
+
+#include <string.h>
+#include "intrinsic.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define WALKS 4
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+  int walk;
+
+  /* Fault everything in first, so that we time only the walks. */
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    buf[i] = (char) (i / PAGE_SIZE);
+
+  for (walk = 0; walk < WALKS; walk++)
+    {
+      uint64_t start = rdtsc ();
+      unsigned sum = 0;
+
+      for (i = 0; i < SIZE; i += PAGE_SIZE)
+        sum += (unsigned char) buf[i];
+      if (sum != (SIZE / PAGE_SIZE) / 256 * (255 * 256 / 2))
+        fail ("walk %d: bad checksum %u", walk, sum);
+
+      msg ("walk %d: 64 MiB in %llu cycles", walk,
+           (unsigned long long) (rdtsc () - start));
+    }
+}
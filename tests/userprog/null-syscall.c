@@ -0,0 +1,34 @@
+/* Makes a system call that does nothing many times and reports
+   the mean round trip, which is the cost of the kernel's entry
+   and exit paths and its dispatch.  Every call must come back
+   with the null call's result, 0. */
+
+#include <syscall.h>
+#include "intrinsic.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CALLS 100000
+
+void
+test_main (void)
+{
+  uint64_t start, cycles;
+  int failed = 0;
+  int i;
+
+  /* Warm up. */
+  for (i = 0; i < 100; i++)
+    if (null_syscall () != 0)
+      fail ("null system call returned nonzero");
+
+  start = rdtsc ();
+  for (i = 0; i < CALLS; i++)
+    failed |= null_syscall ();
+  cycles = rdtsc () - start;
+  if (failed != 0)
+    fail ("null system call returned nonzero");
+
+  msg ("%d null system calls, %llu cycles each", CALLS,
+       (unsigned long long) (cycles / CALLS));
+}
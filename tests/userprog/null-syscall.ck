@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing timing line\n"
+  unless grep (/^\(null-syscall\) 100000 null system calls, \d+ cycles each$/,
+	       @output);
+fail "missing end message\n"
+  unless grep ($_ eq '(null-syscall) end', @output);
+
+pass;
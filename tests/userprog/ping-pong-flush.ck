@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing timing line\n"
+  unless grep (/^\(ping-pong-flush\) 100 round trips in \d+ cycles$/, @output);
+fail "missing end message\n"
+  unless grep ($_ eq '(ping-pong-flush) end', @output);
+
+pass;
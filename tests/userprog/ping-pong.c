@@ -0,0 +1,98 @@
+/* Two processes pass a token back and forth through a pair of
+   pipes and report how long the round trips took.  Each side
+   sleeps in read() until the other writes, so every turn is one
+   switch of address space; after each switch, each side touches a
+   small working set, whose translations survive the switch only
+   if the kernel does not flush the TLB.  At the end each side
+   checks that its working set holds its own writes and none of
+   the other's, as it would not if a stale translation had been
+   used.  ping-pong-flush runs the same program with PCIDs turned
+   off, for comparison. */
+
+#include <stdbool.h>
+#include <syscall.h>
+#include "intrinsic.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 100
+#define PAGE_SIZE 4096
+#define WS_PAGES 32
+
+static char working_set[WS_PAGES * PAGE_SIZE];
+
+static int
+get_token (int fd)
+{
+  int token;
+
+  if (read (fd, &token, sizeof token) != sizeof token)
+    fail ("read token");
+  return token;
+}
+
+static void
+put_token (int fd, int token)
+{
+  if (write (fd, &token, sizeof token) != sizeof token)
+    fail ("write token");
+}
+
+/* Takes every other turn, starting with FIRST: waits for each
+   token on IN and passes the next one on OUT. */
+static void
+play (int in, int out, int first)
+{
+  int turn, i;
+
+  for (turn = first; turn < 2 * ROUNDS; turn += 2)
+    {
+      if (turn > 0 && get_token (in) != turn)
+        fail ("token out of turn");
+      for (i = 0; i < WS_PAGES; i++)
+        working_set[i * PAGE_SIZE]++;
+      put_token (out, turn + 1);
+    }
+}
+
+/* Returns true if every page of the working set was written
+   exactly once per round. */
+static bool
+working_set_ok (void)
+{
+  int i;
+
+  for (i = 0; i < WS_PAGES; i++)
+    if (working_set[i * PAGE_SIZE] != ROUNDS)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  int to_child[2], to_parent[2];
+  uint64_t start;
+  pid_t pid;
+
+  CHECK (pipe (to_child) == 0, "pipe to child");
+  CHECK (pipe (to_parent) == 0, "pipe to parent");
+
+  start = rdtsc ();
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      play (to_child[0], to_parent[1], 1);
+      exit (working_set_ok () ? 0 : 1);
+    }
+  play (to_parent[0], to_child[1], 0);
+  if (get_token (to_parent[0]) != 2 * ROUNDS)
+    fail ("last token out of turn");
+  if (wait (pid) != 0)
+    fail ("child failed");
+  if (!working_set_ok ())
+    fail ("working set saw the child's writes");
+
+  msg ("%d round trips in %llu cycles", ROUNDS,
+       (unsigned long long) (rdtsc () - start));
+}
@@ -0,0 +1,30 @@
+/* Closes each end of a pipe in turn.  Once the write end is
+   closed, read() returns what is left and then end of file; once
+   the read end is closed, write() fails. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char buf[8];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (write (fds[1], "abc", 3) == 3, "write 3 bytes");
+  msg ("close write end");
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 3, "read 3 bytes");
+  if (memcmp (buf, "abc", 3))
+    fail ("read wrong data");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read end of file");
+  close (fds[0]);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  msg ("close read end");
+  close (fds[0]);
+  CHECK (write (fds[1], "abc", 3) == -1, "write fails");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-close) begin
+(pipe-close) pipe
+(pipe-close) write 3 bytes
+(pipe-close) close write end
+(pipe-close) read 3 bytes
+(pipe-close) read end of file
+(pipe-close) pipe
+(pipe-close) close read end
+(pipe-close) write fails
+(pipe-close) end
+pipe-close: exit(0)
+EOF
+pass;
@@ -0,0 +1,115 @@
+/* Times random 4 kB reads from a file three ways: a seek and a
+   read system call each, batches queued on a submission ring and
+   run by one ring_enter() call each, and batches queued on a ring
+   that a kernel thread polls.  Checks the data read each time and
+   reports the mean cycles per read. */
+
+#include <random.h>
+#include <ring.h>
+#include <syscall.h>
+#include <uring.h>
+#include "intrinsic.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (256 * 1024)
+#define BLOCK_SIZE 4096
+#define BLOCK_CNT (FILE_SIZE / BLOCK_SIZE)
+#define READS 256
+#define BATCH 32
+
+/* Where the two rings are mapped. */
+#define RING_ADDR ((void *) 0x10000000)
+#define POLL_RING_ADDR ((void *) 0x10100000)
+
+static uint32_t bufs[BATCH][BLOCK_SIZE / sizeof (uint32_t)];
+static unsigned blocks[READS];
+
+/* Checks that BUF holds block BLOCK: each word of the file is
+   its own offset. */
+static void
+check_block (const uint32_t *buf, unsigned block)
+{
+  size_t i;
+
+  for (i = 0; i < BLOCK_SIZE / sizeof *buf; i++)
+    if (buf[i] != block * BLOCK_SIZE + i * sizeof *buf)
+      fail ("block %u word %zu is %u", block, i, buf[i]);
+}
+
+static uint64_t
+time_read (int fd)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < READS; i++)
+    {
+      seek (fd, blocks[i] * BLOCK_SIZE);
+      if (read (fd, bufs[i % BATCH], BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("read of block %u failed", blocks[i]);
+      check_block (bufs[i % BATCH], blocks[i]);
+    }
+  return (rdtsc () - start) / READS;
+}
+
+static uint64_t
+time_ring (int fd, void *addr, int flags)
+{
+  struct uring ring;
+  uint64_t start;
+  int i, j;
+
+  CHECK (uring_init (&ring, addr, BATCH, flags), "set up ring at %p", addr);
+  start = rdtsc ();
+  for (i = 0; i < READS; i += BATCH)
+    {
+      for (j = 0; j < BATCH; j++)
+        uring_prep_rw (uring_get_sqe (&ring), RING_OP_READ, fd, bufs[j],
+                       BLOCK_SIZE, blocks[i + j] * BLOCK_SIZE, j);
+      uring_submit (&ring);
+      for (j = 0; j < BATCH; j++)
+        {
+          struct ring_cqe cqe;
+
+          uring_wait (&ring, &cqe);
+          if (cqe.res != BLOCK_SIZE)
+            fail ("ring read of block %u returned %lld",
+                  blocks[i + cqe.user_data], (long long) cqe.res);
+          check_block (bufs[cqe.user_data], blocks[i + cqe.user_data]);
+        }
+    }
+  return (rdtsc () - start) / READS;
+}
+
+void
+test_main (void)
+{
+  uint64_t plain, ring, poll;
+  int fd, i;
+
+  CHECK (create ("data", FILE_SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      size_t j;
+
+      for (j = 0; j < BLOCK_SIZE / sizeof (uint32_t); j++)
+        bufs[0][j] = i * BLOCK_SIZE + j * sizeof (uint32_t);
+      if (write (fd, bufs[0], BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("write of block %d failed", i);
+    }
+
+  random_init (0);
+  for (i = 0; i < READS; i++)
+    blocks[i] = random_ulong () % BLOCK_CNT;
+
+  plain = time_read (fd);
+  ring = time_ring (fd, RING_ADDR, 0);
+  poll = time_ring (fd, POLL_RING_ADDR, RING_SQPOLL);
+  close (fd);
+
+  msg ("%d random 4 kB reads: %llu/%llu/%llu cycles each "
+       "(read/ring/ring+poll)", READS, (unsigned long long) plain,
+       (unsigned long long) ring, (unsigned long long) poll);
+}
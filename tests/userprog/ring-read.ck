@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing timing line\n"
+  unless grep (/^\(ring-read\) 256 random 4 kB reads: \d+\/\d+\/\d+ cycles each \(read\/ring\/ring\+poll\)$/,
+	       @output);
+fail "missing end message\n"
+  unless grep ($_ eq '(ring-read) end', @output);
+
+pass;
@@ -0,0 +1,74 @@
+/* Reads the time from the kernel's time page and checks it
+   against the ticks system call: the tick count must agree, and
+   the nanosecond clock must never go backward and must stay
+   within the tick it reports.  Then reports the mean cycles per
+   read of each, against the system call, and checks that reading
+   the page is the cheaper way to get the tick count. */
+
+#include <syscall.h>
+#include <time.h>
+#include "intrinsic.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define READS 100000
+
+/* Timer ticks per second, as in the kernel. */
+#define TIMER_FREQ 100
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+void
+test_main (void)
+{
+  uint64_t start, page_ticks, page_ns, syscall_ticks;
+  uint64_t last_ns = 0;
+  struct timespec ts;
+  int i;
+
+  for (i = 0; i < READS; i++)
+    {
+      int64_t before = ticks ();
+      int64_t now = clock_ticks ();
+      int64_t after = ticks ();
+      uint64_t ns = clock_ns ();
+
+      if (now < before || now > after)
+        fail ("time page read %lld ticks between %lld and %lld",
+              (long long) now, (long long) before, (long long) after);
+      if (ns < last_ns)
+        fail ("clock went backward from %llu to %llu ns",
+              (unsigned long long) last_ns, (unsigned long long) ns);
+      if (ns / NS_PER_TICK < (uint64_t) after - 1
+          || ns / NS_PER_TICK > (uint64_t) ticks ())
+        fail ("clock read %llu ns around tick %lld",
+              (unsigned long long) ns, (long long) after);
+      last_ns = ns;
+    }
+  CHECK (clock_gettime (CLOCK_MONOTONIC, &ts) == 0, "clock_gettime");
+  if (ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000)
+    fail ("clock_gettime returned %ld ns", ts.tv_nsec);
+
+  start = rdtsc ();
+  for (i = 0; i < READS; i++)
+    clock_ticks ();
+  page_ticks = (rdtsc () - start) / READS;
+
+  start = rdtsc ();
+  for (i = 0; i < READS; i++)
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+  page_ns = (rdtsc () - start) / READS;
+
+  start = rdtsc ();
+  for (i = 0; i < READS; i++)
+    ticks ();
+  syscall_ticks = (rdtsc () - start) / READS;
+  if (page_ticks >= syscall_ticks)
+    fail ("time page read took %llu cycles, ticks syscall only %llu",
+          (unsigned long long) page_ticks,
+          (unsigned long long) syscall_ticks);
+
+  msg ("%d reads: %llu/%llu/%llu cycles each "
+       "(page ticks/page clock_gettime/ticks syscall)", READS,
+       (unsigned long long) page_ticks, (unsigned long long) page_ns,
+       (unsigned long long) syscall_ticks);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing timing line\n"
+  unless grep (/^\(time-page\) 100000 reads: \d+\/\d+\/\d+ cycles each \(page ticks\/page clock_gettime\/ticks syscall\)$/,
+	       @output);
+fail "missing end message\n"
+  unless grep ($_ eq '(time-page) end', @output);
+
+pass;
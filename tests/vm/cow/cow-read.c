@@ -0,0 +1,37 @@
+/* Checks that read() into a buffer that a freshly forked child
+   has not yet written gives the child its own copy, instead of
+   writing through into the frame it still shares with its
+   parent. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+
+static char buf[4096];
+
+void
+test_main (void)
+{
+	size_t size = strlen (sample);
+	pid_t child;
+	int handle;
+	size_t i;
+
+	memset (buf, 'P', sizeof buf);
+
+	child = fork ("child");
+	if (child == 0) {
+		CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+		CHECK (read (handle, buf, size) == (int) size, "read into shared buffer");
+		CHECK (memcmp (buf, sample, size) == 0, "check data in child");
+		close (handle);
+		exit (0);
+	}
+	CHECK (wait (child) == 0, "wait for child");
+	for (i = 0; i < sizeof buf; i++)
+		if (buf[i] != 'P')
+			fail ("parent's byte %zu changed to %02hhx", i, buf[i]);
+	msg ("parent's buffer unchanged");
+}
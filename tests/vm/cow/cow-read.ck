@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-read) begin
+(cow-read) open "sample.txt"
+(cow-read) read into shared buffer
+(cow-read) check data in child
+(cow-read) wait for child
+(cow-read) parent's buffer unchanged
+(cow-read) end
+EOF
+pass;
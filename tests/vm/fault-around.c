@@ -0,0 +1,71 @@
+/* Reads one page in the middle of a read-only and of a writable
+   initialized array, each aligned to the 16-page fault-around
+   window, and checks through the physical addresses of the pages
+   that the read mapped the rest of the window too, into adjacent
+   frames filled by one read, but nothing past it.  Then checks
+   that every page of both arrays holds what the executable says,
+   and that the writable one can still be written. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define WINDOW 16
+#define PAGE_CNT (2 * WINDOW)
+
+/* Initializer that puts N+1 at the start of page N. */
+#define MARK(N) [(N) * PAGE_SIZE] = (N) + 1
+#define MARK4(N) MARK (N), MARK ((N) + 1), MARK ((N) + 2), MARK ((N) + 3)
+#define MARKS MARK4 (0), MARK4 (4), MARK4 (8), MARK4 (12), \
+              MARK4 (16), MARK4 (20), MARK4 (24), MARK4 (28)
+
+static const char ro[PAGE_CNT * PAGE_SIZE]
+  __attribute__ ((aligned (WINDOW * PAGE_SIZE))) = { MARKS };
+static char rw[PAGE_CNT * PAGE_SIZE]
+  __attribute__ ((aligned (WINDOW * PAGE_SIZE))) = { MARKS };
+
+static void
+check_window (const char *name, const char *array)
+{
+  const char *base = (const char *) get_phys_addr ((void *) array);
+  int i;
+
+  if (array[5 * PAGE_SIZE] != 6)
+    fail ("%s page 5 holds %d, not 6", name, array[5 * PAGE_SIZE]);
+  for (i = 0; i < WINDOW; i++)
+    {
+      const char *pa = get_phys_addr ((void *) &array[i * PAGE_SIZE]);
+      if (pa == NULL)
+        fail ("%s page %d is not mapped", name, i);
+      if (pa != base + i * PAGE_SIZE)
+        fail ("%s page %d is not next to page %d", name, i, i - 1);
+    }
+  msg ("%s: one fault mapped the whole window", name);
+  CHECK (get_phys_addr ((void *) &array[WINDOW * PAGE_SIZE]) == NULL,
+         "%s: the next window is untouched", name);
+}
+
+static void
+check_contents (const char *name, const char *array)
+{
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (array[i * PAGE_SIZE] != i + 1 || array[i * PAGE_SIZE + 1] != 0)
+      fail ("%s page %d is corrupt", name, i);
+  msg ("%s: contents are intact", name);
+}
+
+void
+test_main (void)
+{
+  check_window ("ro", ro);
+  check_window ("rw", rw);
+  check_contents ("ro", ro);
+  check_contents ("rw", rw);
+
+  rw[3 * PAGE_SIZE] = 42;
+  CHECK (rw[3 * PAGE_SIZE] == 42 && rw[4 * PAGE_SIZE] == 5,
+         "rw: fault-around pages are writable");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-around) begin
+(fault-around) ro: one fault mapped the whole window
+(fault-around) ro: the next window is untouched
+(fault-around) rw: one fault mapped the whole window
+(fault-around) rw: the next window is untouched
+(fault-around) ro: contents are intact
+(fault-around) rw: contents are intact
+(fault-around) rw: fault-around pages are writable
+(fault-around) end
+EOF
+pass;
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+for my $kib (0, 1024, 4096) {
+    fail "missing timing for $kib KiB\n"
+      unless grep (/^\(fork-exit\) $kib KiB touched: fork\+exit\+wait in \d+ cycles, \d+ if the child writes it$/,
+		   @output);
+}
+fail "missing end message\n"
+  unless grep ($_ eq '(fork-exit) end', @output);
+
+pass;
@@ -0,0 +1,82 @@
+/* Compresses pages of several kinds with the kernel's LZ
+   compressor, as the compressed swap pool does, and checks that
+   each decompresses to exactly the original.  Pages of zeros and
+   of repetitive data must shrink to under half a page, so the
+   pool would keep them; a page of random bytes must not. */
+
+#include <lz.h>
+#include <random.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+static uint8_t *page, *comp, *back;
+static void *work;
+
+/* Compresses PAGE and checks that it round-trips.  Returns its
+   compressed size, or 0 if it does not fit in a page. */
+static size_t
+round_trip (const char *kind)
+{
+  size_t size = lz_compress (page, PGSIZE, comp, PGSIZE, work);
+
+  if (size == 0)
+    return 0;
+  memset (back, 0xcc, PGSIZE);
+  if (!lz_decompress (comp, size, back, PGSIZE)
+      || memcmp (page, back, PGSIZE) != 0)
+    fail ("%s page does not round-trip", kind);
+  if (lz_decompress (comp, size, back, PGSIZE - 1))
+    fail ("%s page decompresses into a short buffer", kind);
+  return size;
+}
+
+/* Checks that PAGE round-trips and that it compresses to less
+   than half a page if and only if SHRINKS. */
+static void
+expect_shrinks (const char *kind, bool shrinks)
+{
+  size_t size = round_trip (kind);
+
+  if ((size != 0 && size < PGSIZE / 2) != shrinks)
+    fail ("%s page compresses to %zu bytes", kind, size);
+  msg ("%s page %s", kind, shrinks ? "shrinks" : "does not shrink");
+}
+
+void
+test_lz_page (void)
+{
+  static const char text[] = "the quick brown fox jumps over the lazy dog; ";
+  size_t i;
+
+  page = palloc_get_page (PAL_ASSERT);
+  comp = palloc_get_page (PAL_ASSERT);
+  back = palloc_get_page (PAL_ASSERT);
+  work = malloc (LZ_WORK_SIZE);
+  if (work == NULL)
+    fail ("out of memory");
+  random_init (0);
+
+  memset (page, 0, PGSIZE);
+  expect_shrinks ("zero", true);
+
+  for (i = 0; i < PGSIZE; i++)
+    page[i] = text[i % (sizeof text - 1)];
+  expect_shrinks ("text", true);
+
+  for (i = 0; i < PGSIZE; i++)
+    page[i] = i % 64 == 0 ? random_ulong () : i / 64;
+  expect_shrinks ("mixed", true);
+
+  for (i = 0; i < PGSIZE; i++)
+    page[i] = random_ulong ();
+  expect_shrinks ("random", false);
+
+  free (work);
+  palloc_free_page (back);
+  palloc_free_page (comp);
+  palloc_free_page (page);
+  pass ();
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lz-page) begin
+(lz-page) zero page shrinks
+(lz-page) text page shrinks
+(lz-page) mixed page shrinks
+(lz-page) random page does not shrink
+(lz-page) PASS
+(lz-page) end
+EOF
+pass;
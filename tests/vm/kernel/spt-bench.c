@@ -0,0 +1,194 @@
+/* Compares the radix-tree supplemental page table against a
+   hash-table one for tables of 1k to 1M pages.  For each size,
+   reports the mean cycles per insert and per lookup of a random
+   resident page, and the worst single insert, which for the
+   hash table includes the stalls where it rehashes as it grows.
+   Page faults do one lookup each, and exec and fork do one
+   insert per page. */
+
+#include <hash.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#include "intrinsic.h"
+
+/* Number of random lookups timed for each size. */
+#define LOOKUP_CNT 100000
+
+/* Address of the first page in each table. */
+#define BASE ((uint8_t *) 0x10000000)
+
+/* Page in the hash-table baseline. */
+struct hpage
+  {
+    struct hash_elem elem;
+    void *va;
+  };
+
+static uint64_t
+hpage_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct hpage *p = hash_entry (e, struct hpage, elem);
+  return hash_bytes (&p->va, sizeof p->va);
+}
+
+static bool
+hpage_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return hash_entry (a, struct hpage, elem)->va
+         < hash_entry (b, struct hpage, elem)->va;
+}
+
+static void
+hpage_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct hpage, elem));
+}
+
+/* Cycle counts for one table type at one size. */
+struct result
+  {
+    uint64_t insert;            /* Total over all inserts. */
+    uint64_t worst;             /* Slowest single insert. */
+    uint64_t lookup;            /* Total over all lookups. */
+  };
+
+static void
+bench_radix (size_t page_cnt, const size_t *idx, struct result *r)
+{
+  struct supplemental_page_table spt;
+  struct page **pages;
+  enum intr_level old_level;
+  uint64_t start;
+  size_t i;
+
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL)
+    fail ("out of memory for %zu pages", page_cnt);
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = malloc (sizeof *pages[i]);
+      if (pages[i] == NULL)
+        fail ("out of memory for %zu pages", page_cnt);
+      uninit_new (pages[i], BASE + i * PGSIZE, NULL, VM_ANON, NULL,
+                  anon_initializer);
+    }
+
+  supplemental_page_table_init (&spt);
+  old_level = intr_disable ();
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint64_t t;
+
+      start = rdtsc ();
+      if (!spt_insert_page (&spt, pages[i]))
+        fail ("radix insert of page %zu failed", i);
+      t = rdtsc () - start;
+      r->insert += t;
+      if (t > r->worst)
+        r->worst = t;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < LOOKUP_CNT; i++)
+    if (spt_find_page (&spt, BASE + idx[i] * PGSIZE) != pages[idx[i]])
+      fail ("radix lookup of page %zu failed", idx[i]);
+  r->lookup = rdtsc () - start;
+  intr_set_level (old_level);
+
+  supplemental_page_table_kill (&spt);
+  free (pages);
+}
+
+static void
+bench_hash (size_t page_cnt, const size_t *idx, struct result *r)
+{
+  struct hash h;
+  struct hpage **pages;
+  enum intr_level old_level;
+  uint64_t start;
+  size_t i;
+
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL || !hash_init (&h, hpage_hash, hpage_less, NULL))
+    fail ("out of memory for %zu pages", page_cnt);
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = malloc (sizeof *pages[i]);
+      if (pages[i] == NULL)
+        fail ("out of memory for %zu pages", page_cnt);
+      pages[i]->va = BASE + i * PGSIZE;
+    }
+
+  old_level = intr_disable ();
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint64_t t;
+
+      start = rdtsc ();
+      if (hash_insert (&h, &pages[i]->elem) != NULL)
+        fail ("hash insert of page %zu failed", i);
+      t = rdtsc () - start;
+      r->insert += t;
+      if (t > r->worst)
+        r->worst = t;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < LOOKUP_CNT; i++)
+    {
+      struct hpage key;
+      struct hash_elem *e;
+
+      key.va = BASE + idx[i] * PGSIZE;
+      e = hash_find (&h, &key.elem);
+      if (e == NULL || hash_entry (e, struct hpage, elem) != pages[idx[i]])
+        fail ("hash lookup of page %zu failed", idx[i]);
+    }
+  r->lookup = rdtsc () - start;
+  intr_set_level (old_level);
+
+  hash_destroy (&h, hpage_free);
+  free (pages);
+}
+
+void
+test_spt_bench (void)
+{
+  size_t page_cnt;
+  size_t *idx;
+
+  idx = malloc (LOOKUP_CNT * sizeof *idx);
+  if (idx == NULL)
+    fail ("out of memory for lookup indexes");
+
+  random_init (0);
+  for (page_cnt = 1024; page_cnt <= 1024 * 1024; page_cnt *= 4)
+    {
+      struct result radix = { 0, 0, 0 };
+      struct result hash = { 0, 0, 0 };
+      size_t i;
+
+      for (i = 0; i < LOOKUP_CNT; i++)
+        idx[i] = random_ulong () % page_cnt;
+
+      bench_radix (page_cnt, idx, &radix);
+      bench_hash (page_cnt, idx, &hash);
+
+      msg ("%zu pages: insert %"PRIu64"/%"PRIu64", "
+           "worst insert %"PRIu64"/%"PRIu64", "
+           "lookup %"PRIu64"/%"PRIu64" cycles (radix/hash)",
+           page_cnt, radix.insert / page_cnt, hash.insert / page_cnt,
+           radix.worst, hash.worst,
+           radix.lookup / LOOKUP_CNT, hash.lookup / LOOKUP_CNT);
+    }
+
+  free (idx);
+  pass ();
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+for (my $pages = 1024; $pages <= 1024 * 1024; $pages *= 4) {
+    fail "missing timing for $pages pages\n"
+      unless grep (/^\(spt-bench\) $pages pages: insert \d+\/\d+, worst insert \d+\/\d+, lookup \d+\/\d+ cycles \(radix\/hash\)$/,
+		   @output);
+}
+fail "missing PASS message\n"
+  unless grep ($_ eq '(spt-bench) PASS', @output);
+
+pass;
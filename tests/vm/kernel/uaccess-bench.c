@@ -0,0 +1,207 @@
+/* Compares the fault-fixup user copy primitives against copying
+   after looking each page up in the page table, as a system call
+   that validates its pointers first would.  Sets up a user
+   address space in the running kernel thread, checks that
+   copies from good addresses succeed and copies that touch bad
+   ones fail with -EFAULT, then reports the mean cycles per copy
+   for buffers of 4 bytes to 64 kB, the sizes write() and read()
+   see, and per copy of a 32-byte string, as exec() does for
+   each argument. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
+#include "intrinsic.h"
+
+/* User buffer: BUF_PAGES mapped pages from BASE, with nothing
+   mapped just past them. */
+#define BUF_PAGES 16
+#define BUF_SIZE (BUF_PAGES * PGSIZE)
+#define BASE ((uint8_t *) 0x10000000)
+
+/* Copies timed at each size. */
+#define COPY_CNT 2000
+
+/* Buffer sizes timed: 4 bytes, then each 4 times the last. */
+#define SIZE_CNT 8
+
+/* Length of the timed string, not counting its null. */
+#define STR_LEN 32
+
+static uint8_t kbuf[BUF_SIZE];
+
+/* Copies SIZE bytes from USRC to DST after looking up each user
+   page it spans, a page at a time.  Returns 0 or -EFAULT. */
+static int
+validated_copy (void *dst, const void *usrc, size_t size)
+{
+  uint64_t *pml4 = thread_current ()->pml4;
+  const uint8_t *src = usrc;
+  uint8_t *d = dst;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (src);
+      uint8_t *kpage;
+
+      if (chunk > size)
+        chunk = size;
+      if (!is_user_vaddr (src)
+          || (kpage = pml4_get_page (pml4, pg_round_down (src))) == NULL)
+        return -EFAULT;
+      memcpy (d, kpage + pg_ofs (src), chunk);
+      src += chunk;
+      d += chunk;
+      size -= chunk;
+    }
+  return 0;
+}
+
+/* Copies the string at USRC into DST, a SIZE-byte buffer, looking
+   up the user page of each byte before reading it.  Returns the
+   string's length, SIZE if it does not fit, or -EFAULT. */
+static long
+validated_strncpy (char *dst, const char *usrc, size_t size)
+{
+  uint64_t *pml4 = thread_current ()->pml4;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      const char *kpage;
+
+      if (!is_user_vaddr (usrc + i)
+          || (kpage = pml4_get_page (pml4, pg_round_down (usrc + i))) == NULL)
+        return -EFAULT;
+      dst[i] = kpage[pg_ofs (usrc + i)];
+      if (dst[i] == '\0')
+        return i;
+    }
+  return size;
+}
+
+/* Checks the primitives against good and bad addresses. */
+static void
+check_copies (void)
+{
+  char str[64];
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    BASE[i] = i * 7;
+  memset (kbuf, 0, sizeof kbuf);
+  if (copy_from_user (kbuf, BASE, BUF_SIZE) != 0
+      || memcmp (kbuf, BASE, BUF_SIZE) != 0)
+    fail ("copy_from_user of the whole buffer failed");
+  memset (kbuf, 0x5a, PGSIZE);
+  if (copy_to_user (BASE + 100, kbuf, PGSIZE) != 0
+      || BASE[99] != (uint8_t) (99 * 7) || BASE[100] != 0x5a
+      || BASE[100 + PGSIZE - 1] != 0x5a)
+    fail ("copy_to_user across a page boundary failed");
+
+  if (copy_from_user (kbuf, BASE + BUF_SIZE, 1) != -EFAULT)
+    fail ("copy_from_user of an unmapped page succeeded");
+  if (copy_from_user (kbuf, BASE + BUF_SIZE - 16, 32) != -EFAULT)
+    fail ("copy_from_user running off the mapping succeeded");
+  if (copy_to_user (BASE + BUF_SIZE - 1, kbuf, 2) != -EFAULT)
+    fail ("copy_to_user running off the mapping succeeded");
+  if (copy_from_user (kbuf, (void *) ptov (0), 1) != -EFAULT)
+    fail ("copy_from_user of a kernel address succeeded");
+  if (copy_from_user (kbuf, NULL, 1) != -EFAULT)
+    fail ("copy_from_user of a null pointer succeeded");
+
+  strlcpy ((char *) BASE, "hello, world", PGSIZE);
+  if (strncpy_from_user (str, (char *) BASE, sizeof str) != 12
+      || strcmp (str, "hello, world") != 0)
+    fail ("strncpy_from_user of a short string failed");
+  if (strncpy_from_user (str, (char *) BASE, 5) != 5)
+    fail ("strncpy_from_user did not truncate to the buffer");
+  memset (BASE + BUF_SIZE - 8, 'x', 8);
+  if (strncpy_from_user (str, (char *) BASE + BUF_SIZE - 8, sizeof str)
+      != -EFAULT)
+    fail ("strncpy_from_user running off the mapping succeeded");
+}
+
+/* Returns the mean cycles per copy of SIZE bytes with COPY. */
+static uint64_t
+time_copy (int (*copy) (void *, const void *, size_t), size_t size)
+{
+  uint64_t start;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < COPY_CNT; i++)
+    if (copy (kbuf, BASE, size) != 0)
+      fail ("timed copy of %zu bytes failed", size);
+  return (rdtsc () - start) / COPY_CNT;
+}
+
+/* Returns the mean cycles per copy of the string at BASE with
+   COPY. */
+static uint64_t
+time_strncpy (long (*copy) (char *, const char *, size_t))
+{
+  char str[STR_LEN + 1];
+  uint64_t start;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < COPY_CNT; i++)
+    if (copy (str, (char *) BASE, sizeof str) != STR_LEN)
+      fail ("timed string copy failed");
+  return (rdtsc () - start) / COPY_CNT;
+}
+
+void
+test_uaccess_bench (void)
+{
+  struct thread *t = thread_current ();
+  uint64_t *old_pml4 = t->pml4;
+  uint64_t fixup[SIZE_CNT], validated[SIZE_CNT], str_fixup, str_validated;
+  enum intr_level old_level;
+  int i;
+
+  t->pml4 = pml4_create ();
+  if (t->pml4 == NULL)
+    fail ("out of memory for page table");
+  for (i = 0; i < BUF_PAGES; i++)
+    {
+      void *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (kpage == NULL
+          || !pml4_set_page (t->pml4, BASE + i * PGSIZE, kpage, true))
+        fail ("out of memory for user buffer");
+    }
+  pml4_activate (t->pml4);
+
+  check_copies ();
+
+  memset (BASE, 'a', STR_LEN);
+  BASE[STR_LEN] = '\0';
+  old_level = intr_disable ();
+  for (i = 0; i < SIZE_CNT; i++)
+    {
+      fixup[i] = time_copy (copy_from_user, (size_t) 4 << (2 * i));
+      validated[i] = time_copy (validated_copy, (size_t) 4 << (2 * i));
+    }
+  str_fixup = time_strncpy (strncpy_from_user);
+  str_validated = time_strncpy (validated_strncpy);
+  intr_set_level (old_level);
+
+  for (i = 0; i < SIZE_CNT; i++)
+    msg ("%zu bytes: %"PRIu64"/%"PRIu64" cycles (fixup/validated)",
+         (size_t) 4 << (2 * i), fixup[i], validated[i]);
+  msg ("%d-byte string: %"PRIu64"/%"PRIu64" cycles (fixup/validated)",
+       STR_LEN, str_fixup, str_validated);
+
+  pml4_activate (old_pml4);
+  pml4_destroy (t->pml4);
+  t->pml4 = old_pml4;
+  pass ();
+}
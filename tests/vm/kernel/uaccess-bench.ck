@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+for (my $size = 4; $size <= 65536; $size *= 4) {
+    fail "missing timing for $size bytes\n"
+      unless grep (/^\(uaccess-bench\) $size bytes: \d+\/\d+ cycles \(fixup\/validated\)$/,
+		   @output);
+}
+fail "missing string timing\n"
+  unless grep (/^\(uaccess-bench\) 32-byte string: \d+\/\d+ cycles \(fixup\/validated\)$/,
+	       @output);
+fail "missing PASS message\n"
+  unless grep ($_ eq '(uaccess-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,68 @@
+/* Touches 8 MiB of BSS, which the kernel may map with 2 MiB pages,
+   then changes single pages inside it: a child writes one after
+   fork, and the parent discards another with MADV_DONTNEED.  Each
+   change splits the large page around it, and every other page
+   must keep its contents. */
+
+#include <mman.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (8 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define PAGE_CNT (SIZE / PAGE_SIZE)
+
+static char data[SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+/* Returns the word at the start of page IDX of DATA. */
+static uint32_t *
+word (size_t idx)
+{
+  return (uint32_t *) (data + idx * PAGE_SIZE);
+}
+
+/* Checks that every page but SKIP holds its own index. */
+static void
+check_pages (size_t skip)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (i != skip && *word (i) != i)
+      fail ("page %zu holds %u", i, *word (i));
+}
+
+void
+test_main (void)
+{
+  size_t child_page = PAGE_CNT / 2 + 1;
+  size_t discard_page = PAGE_CNT / 4 + 3;
+  pid_t pid;
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    *word (i) = i;
+  check_pages (SIZE_MAX);
+  msg ("touched 8 MiB");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      *word (child_page) = 0xdeadbeef;
+      check_pages (child_page);
+      exit (*word (child_page) == 0xdeadbeef ? 0 : 1);
+    }
+  CHECK (pid > 0, "fork");
+  CHECK (wait (pid) == 0, "wait for child");
+  check_pages (SIZE_MAX);
+  msg ("parent unchanged by child's write");
+
+  CHECK (madvise (word (discard_page), PAGE_SIZE, MADV_DONTNEED) == 0,
+         "discard one page");
+  if (*word (discard_page) != 0)
+    fail ("discarded page holds %u", *word (discard_page));
+  check_pages (discard_page);
+  msg ("other pages unchanged by discard");
+}
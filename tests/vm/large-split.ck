@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(large-split) begin
+(large-split) touched 8 MiB
+(large-split) fork
+(large-split) wait for child
+(large-split) parent unchanged by child's write
+(large-split) discard one page
+(large-split) other pages unchanged by discard
+(large-split) end
+EOF
+pass;
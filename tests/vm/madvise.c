@@ -0,0 +1,71 @@
+/* Checks each madvise() hint through the physical addresses the
+   pages of some initialized arrays map to: MADV_WILLNEED brings a
+   range in without touching it, MADV_SEQUENTIAL makes one fault
+   read far past the usual 16-page window, MADV_RANDOM makes a
+   fault read only its own page, and MADV_DONTNEED drops written
+   pages so that they read as zeros.  Also checks that a misaligned
+   address is refused. */
+
+#include <mman.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+/* Initializer that puts 1 at the start of each page. */
+#define MARK(N) [(N) * PAGE_SIZE] = 1
+#define MARK4(N) MARK (N), MARK ((N) + 1), MARK ((N) + 2), MARK ((N) + 3)
+#define MARK16(N) MARK4 (N), MARK4 ((N) + 4), MARK4 ((N) + 8), MARK4 ((N) + 12)
+#define MARKS MARK16 (0), MARK16 (16), MARK16 (32), MARK16 (48)
+
+#define ARRAY(NAME) \
+  static char NAME[PAGE_CNT * PAGE_SIZE] \
+    __attribute__ ((aligned (PAGE_CNT * PAGE_SIZE))) = { MARKS }
+
+ARRAY (willneed);
+ARRAY (sequential);
+ARRAY (random);
+ARRAY (dontneed);
+
+/* Returns true if page N of ARRAY is mapped. */
+static bool
+mapped (const char *array, int n)
+{
+  return get_phys_addr ((void *) &array[n * PAGE_SIZE]) != NULL;
+}
+
+void
+test_main (void)
+{
+  int i;
+
+  CHECK (madvise (willneed, 4 * PAGE_SIZE, MADV_WILLNEED) == 0,
+         "MADV_WILLNEED");
+  for (i = 0; i < 4; i++)
+    if (!mapped (willneed, i) || willneed[i * PAGE_SIZE] != 1)
+      fail ("page %d was not brought in", i);
+  CHECK (!mapped (willneed, 4), "brought in just the range");
+
+  CHECK (madvise (sequential, sizeof sequential, MADV_SEQUENTIAL) == 0,
+         "MADV_SEQUENTIAL");
+  CHECK (sequential[0] == 1 && mapped (sequential, 40),
+         "one fault read far ahead");
+
+  CHECK (madvise (random, sizeof random, MADV_RANDOM) == 0, "MADV_RANDOM");
+  CHECK (random[0] == 1 && !mapped (random, 1), "one fault read one page");
+
+  for (i = 0; i < 4; i++)
+    dontneed[i * PAGE_SIZE] = 2;
+  CHECK (madvise (dontneed, 4 * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "MADV_DONTNEED");
+  for (i = 0; i < 4; i++)
+    if (dontneed[i * PAGE_SIZE] != 0)
+      fail ("page %d holds %d after MADV_DONTNEED", i,
+            dontneed[i * PAGE_SIZE]);
+  msg ("dropped pages read as zeros");
+
+  CHECK (madvise (dontneed + 1, PAGE_SIZE, MADV_DONTNEED) == -1,
+         "misaligned address is refused");
+}
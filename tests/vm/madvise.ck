@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) MADV_WILLNEED
+(madvise) brought in just the range
+(madvise) MADV_SEQUENTIAL
+(madvise) one fault read far ahead
+(madvise) MADV_RANDOM
+(madvise) one fault read one page
+(madvise) MADV_DONTNEED
+(madvise) dropped pages read as zeros
+(madvise) misaligned address is refused
+(madvise) end
+EOF
+pass;
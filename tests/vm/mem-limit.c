@@ -0,0 +1,53 @@
+/* Forks a child that limits itself to a few hundred frames and
+   then writes more memory than the machine has, and checks that
+   the child reclaims its own pages rather than pushing out the
+   pages of its parent, which sits idle meanwhile. */
+
+#include <mman.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CALM_PAGES 64           /* Parent's working set. */
+#define HUNGRY_PAGES 3072       /* 12 MB, more than user memory. */
+#define LIMIT 256               /* Child's frame limit. */
+
+static char calm[CALM_PAGES * PAGE_SIZE];
+static char hungry[HUNGRY_PAGES * PAGE_SIZE];
+
+static void
+eat (void)
+{
+  size_t i;
+
+  CHECK (setmemlimit (LIMIT, MEM_UNLIMITED) == 0, "limit child to %d frames",
+         LIMIT);
+  for (i = 0; i < HUNGRY_PAGES; i++)
+    hungry[i * PAGE_SIZE] = 1;
+  for (i = 0; i < HUNGRY_PAGES; i++)
+    if (hungry[i * PAGE_SIZE] != 1)
+      fail ("child's page %zu is corrupted", i);
+  msg ("child wrote %d pages", HUNGRY_PAGES);
+  exit (0x42);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  for (i = 0; i < CALM_PAGES; i++)
+    calm[i * PAGE_SIZE] = i + 1;
+
+  child = fork ("hungry");
+  if (child == 0)
+    eat ();
+  CHECK (wait (child) == 0x42, "wait for child");
+
+  for (i = 0; i < CALM_PAGES; i++)
+    if (get_phys_addr (&calm[i * PAGE_SIZE]) == NULL)
+      fail ("parent's page %zu was pushed out", i);
+  msg ("parent's pages all stayed resident");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mem-limit) begin
+(mem-limit) limit child to 256 frames
+(mem-limit) child wrote 3072 pages
+(mem-limit) wait for child
+(mem-limit) parent's pages all stayed resident
+(mem-limit) end
+EOF
+pass;
@@ -0,0 +1,22 @@
+/* Verifies that a memory mapping cannot overlap a submission ring,
+   whose pages the kernel maps outside the supplemental page
+   table, and that the ring is still there afterward. */
+
+#include <ring.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *ring = (char *) 0x10000000;
+  int handle;
+
+  CHECK (ring_setup (ring, 8, 0) >= 0, "set up ring");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (ring, 4096, 0, handle, 0) == MAP_FAILED,
+         "try to mmap over ring");
+  CHECK (((struct ring_hdr *) ring)->entries == 8, "read ring header");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-over-ring) begin
+(mmap-over-ring) set up ring
+(mmap-over-ring) open "sample.txt"
+(mmap-over-ring) try to mmap over ring
+(mmap-over-ring) read ring header
+(mmap-over-ring) end
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Maps a file with MAP_POPULATE and checks that all of its pages
+   are resident before any of them is touched, and hold the file's
+   data.  Maps it again without the flag for contrast: those
+   pages come in only when faulted. */
+
+#include <mman.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/small.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+/* Returns true if every page of the LENGTH bytes at ADDR is
+   mapped. */
+static bool
+all_mapped (const char *addr, size_t length)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < length; ofs += PAGE_SIZE)
+    if (get_phys_addr ((void *) (addr + ofs)) == NULL)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  char *populated = (char *) 0x10000000;
+  char *lazy = (char *) 0x20000000;
+  size_t size = strlen (small);
+  int handle;
+
+  CHECK ((handle = open ("small.txt")) > 1, "open \"small.txt\"");
+  CHECK (mmap_flags (populated, size, 0, handle, 0, MAP_POPULATE)
+         != MAP_FAILED, "mmap \"small.txt\" with MAP_POPULATE");
+  CHECK (mmap (lazy, size, 0, handle, 0) != MAP_FAILED,
+         "mmap \"small.txt\" again");
+  CHECK (mmap_flags (lazy + 0x1000000, size, 0, handle, 0, 0x80)
+         == MAP_FAILED, "mmap with an unknown flag fails");
+  close (handle);
+
+  CHECK (all_mapped (populated, size), "populated pages are resident");
+  CHECK (get_phys_addr (lazy) == NULL, "lazy pages are not");
+  if (memcmp (populated, small, size))
+    fail ("populated mapping reported bad data");
+  if (memcmp (lazy, small, size))
+    fail ("lazy mapping reported bad data");
+}
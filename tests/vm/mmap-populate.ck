@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-populate) begin
+(mmap-populate) open "small.txt"
+(mmap-populate) mmap "small.txt" with MAP_POPULATE
+(mmap-populate) mmap "small.txt" again
+(mmap-populate) mmap with an unknown flag fails
+(mmap-populate) populated pages are resident
+(mmap-populate) lazy pages are not
+(mmap-populate) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Writes to a file through a mapping and checks that msync()
+   with MS_SYNC puts the data in the file while the mapping stays
+   in place.  Runs with background writeback off, so the file
+   holds only zeros until msync(). */
+
+#include <mman.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+static char buf[4096];
+
+/* Reads the first SIZE bytes of file HANDLE into BUF. */
+static void
+read_back (int handle, size_t size)
+{
+  seek (handle, 0);
+  if (read (handle, buf, size) != (int) size)
+    fail ("read of \"sample.txt\" came up short");
+}
+
+void
+test_main (void)
+{
+  size_t size = strlen (sample);
+  int handle;
+  size_t i;
+
+  CHECK (create ("sample.txt", size), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (ACTUAL, size, 1, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, size);
+
+  read_back (handle, size);
+  for (i = 0; i < size; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu reached the file before msync", i);
+  msg ("file unchanged before msync");
+
+  CHECK (msync (ACTUAL, size, 0) == -1, "msync with bad flags fails");
+  CHECK (msync (ACTUAL, size, MS_SYNC) == 0, "msync MS_SYNC");
+  read_back (handle, size);
+  CHECK (!memcmp (buf, sample, size), "compare file against mapping");
+
+  /* Still mapped, and cleaned: a second write goes out too. */
+  ACTUAL[0] = '#';
+  CHECK (msync (ACTUAL, size, MS_SYNC) == 0, "msync again");
+  read_back (handle, 1);
+  CHECK (buf[0] == '#', "second write reached the file");
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(msync) begin
+(msync) create "sample.txt"
+(msync) open "sample.txt"
+(msync) mmap "sample.txt"
+(msync) file unchanged before msync
+(msync) msync with bad flags fails
+(msync) msync MS_SYNC
+(msync) compare file against mapping
+(msync) msync again
+(msync) second write reached the file
+(msync) end
+EOF
+pass;
@@ -0,0 +1,74 @@
+/* Runs a second copy of itself while it is still running, and
+   checks through the physical addresses of their pages that both
+   copies map the same frame for a page of their code, but that
+   each has a private frame for a page of data it has written. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* A page of code: page-aligned, and followed by the rest of the
+   program's code, so the page is backed by the file in full. */
+__attribute__ ((aligned (4096), noinline)) static int
+code (int x)
+{
+  return x + 1;
+}
+
+static int data = 1;
+
+/* Exit codes of the second copy.  fail() exits with 1. */
+#define SHARED 0                /* Code page shared, data page not. */
+#define OWN_CODE 2              /* Code page read again. */
+#define SHARED_DATA 3           /* Written data page shared. */
+
+/* Run as the second copy, with the physical addresses the first
+   one found.  Returns one of the codes above. */
+static int
+child (const char *code_pa, const char *data_pa)
+{
+  data = code (data);
+  if (get_phys_addr ((void *) code) != (void *) (uintptr_t) atoi (code_pa))
+    return OWN_CODE;
+  if (get_phys_addr (&data) == (void *) (uintptr_t) atoi (data_pa))
+    return SHARED_DATA;
+  return SHARED;
+}
+
+int
+main (int argc, char *argv[])
+{
+  char cmd[64];
+  pid_t pid;
+
+  test_name = "share-text";
+  if (argc == 3)
+    return child (argv[1], argv[2]);
+
+  msg ("begin");
+  data = code (data);
+  snprintf (cmd, sizeof cmd, "share-text %d %d",
+            (int) (uintptr_t) get_phys_addr ((void *) code),
+            (int) (uintptr_t) get_phys_addr (&data));
+
+  pid = fork ("share-text");
+  if (pid == 0 && exec (cmd) == -1)
+    fail ("exec \"%s\"", cmd);
+  if (pid < 0)
+    fail ("fork");
+  switch (wait (pid))
+    {
+    case SHARED:
+      msg ("code page shared, data page private");
+      break;
+    case OWN_CODE:
+      fail ("second copy read its own code page");
+    case SHARED_DATA:
+      fail ("second copy shares a written data page");
+    default:
+      fail ("second copy failed");
+    }
+  msg ("end");
+  return 0;
+}
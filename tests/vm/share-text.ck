@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(share-text) begin
+(share-text) code page shared, data page private
+(share-text) end
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Writes more memory than the machine has, so that the first half
+   ends up in swap, then reads part of it back twice: every fourth
+   page in order, and as many other pages in random order.  The
+   strided walk should run faster, since the kernel recognizes the
+   stride and reads the pages ahead of the faults on them; the
+   random walk waits for every page. */
+
+#include <random.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "intrinsic.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 2048           /* 8 MB, more than user memory. */
+#define STRIDE 4
+#define WALK_CNT (PAGE_CNT / 2 / STRIDE)
+
+static char data[PAGE_CNT * PAGE_SIZE];
+static size_t order[WALK_CNT];
+
+/* Reads back page IDX, which must hold its own index. */
+static void
+check_page (size_t idx)
+{
+  uint32_t *p = (uint32_t *) (data + idx * PAGE_SIZE);
+
+  if (*p != idx)
+    fail ("page %zu holds %u", idx, *p);
+}
+
+void
+test_main (void)
+{
+  uint64_t start, strided, shuffled;
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    *(uint32_t *) (data + i * PAGE_SIZE) = i;
+
+  /* Pages 0, 4, 8, ... of the first half, in order. */
+  start = rdtsc ();
+  for (i = 0; i < WALK_CNT; i++)
+    check_page (i * STRIDE);
+  strided = (rdtsc () - start) / WALK_CNT;
+
+  /* Pages 2, 6, 10, ... of the first half, shuffled. */
+  for (i = 0; i < WALK_CNT; i++)
+    order[i] = i * STRIDE + STRIDE / 2;
+  for (i = WALK_CNT - 1; i > 0; i--)
+    {
+      size_t j = random_ulong () % (i + 1);
+      size_t t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+  start = rdtsc ();
+  for (i = 0; i < WALK_CNT; i++)
+    check_page (order[i]);
+  shuffled = (rdtsc () - start) / WALK_CNT;
+
+  msg ("%d swapped pages: %llu cycles each %d apart, %llu in random order",
+       WALK_CNT, (unsigned long long) strided, STRIDE,
+       (unsigned long long) shuffled);
+}
@@ -0,0 +1,43 @@
+/* Reads through a large BSS array that is never written and
+   checks, through the physical addresses its pages map to, that
+   they all share one zero frame, so resident memory stays flat no
+   matter how much is read.  The array is larger than physical
+   memory and swap together.  Then writes one page and checks that
+   only that page gets a frame of its own. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (16 * 1024 * 1024)
+
+static char big[SIZE];
+
+void
+test_main (void)
+{
+  void *zero_pa;
+  size_t i;
+
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    if (big[i] != 0)
+      fail ("byte %zu is %d, not zero", i, big[i]);
+  msg ("read %d MiB of zeros", SIZE / 1024 / 1024);
+
+  zero_pa = get_phys_addr (big);
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    if (get_phys_addr (&big[i]) != zero_pa)
+      fail ("page %zu has a frame of its own", i / PAGE_SIZE);
+  msg ("all pages share one frame");
+
+  big[PAGE_SIZE] = 1;
+  CHECK (get_phys_addr (&big[PAGE_SIZE]) != zero_pa,
+         "written page has a frame of its own");
+  CHECK (get_phys_addr (&big[0]) == zero_pa
+         && get_phys_addr (&big[2 * PAGE_SIZE]) == zero_pa,
+         "its neighbours still share the zero frame");
+  CHECK (big[PAGE_SIZE] == 1 && big[0] == 0 && big[2 * PAGE_SIZE] == 0,
+         "contents are intact");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-bss) begin
+(zero-bss) read 16 MiB of zeros
+(zero-bss) all pages share one frame
+(zero-bss) written page has a frame of its own
+(zero-bss) its neighbours still share the zero frame
+(zero-bss) contents are intact
+(zero-bss) end
+EOF
+pass;
@@ -25,12 +25,14 @@
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/ring.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -147,15 +149,28 @@ static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
 	int perm;
-	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_PGTABLE);
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
+	// Whole 2 MiB chunks are mapped with a single large PDE, which
+	// saves page tables and TLB entries.  The first chunk, which
+	// holds the legacy BIOS and video holes, and the chunks that hold
+	// kernel text, which must stay read-only, use 4 kB pages.
 	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
+		if (pa != 0 && large_pg_ofs (pa) == 0 && pa + LARGE_PGSIZE <= mem_end
+				&& (va + LARGE_PGSIZE <= (uint64_t) &start
+					|| va >= (uint64_t) &_end_kernel_text)) {
+			if ((pte = pml4_pde_walk (pml4, va, 1)) != NULL)
+				*pte = pa | PTE_P | PTE_W | PTE_PS | PTE_G;
+			pa += LARGE_PGSIZE - PGSIZE;
+			continue;
+		}
+
+		perm = PTE_P | PTE_W | PTE_G;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
@@ -165,6 +180,9 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+
+	// Kernel mappings are global; tag address spaces if possible.
+	tlb_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -224,6 +242,40 @@ parse_options (char **argv) {
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
+		else if (!strcmp (name, "-umin"))
+			user_page_reserve = atoi (value);
+		else if (!strcmp (name, "-no-pcid"))
+			tlb_use_pcid = false;
+		else if (!strcmp (name, "-no-large"))
+			large_pages = false;
+#endif
+		else if (!strcmp (name, "-kmin"))
+			kernel_page_reserve = atoi (value);
+#ifdef VM
+		else if (!strcmp (name, "-fault-around"))
+			fault_around_pages = atoi (value);
+		else if (!strcmp (name, "-zswap"))
+			zswap_percent = atoi (value);
+		else if (!strcmp (name, "-wmark-min"))
+			wmark_min = atoi (value);
+		else if (!strcmp (name, "-wmark-low"))
+			wmark_low = atoi (value);
+		else if (!strcmp (name, "-wmark-high"))
+			wmark_high = atoi (value);
+		else if (!strcmp (name, "-writeback"))
+			writeback_interval = atoi (value);
+		else if (!strcmp (name, "-rss"))
+			rss_report = true;
+		else if (!strcmp (name, "-rss-limit"))
+			rss_limit_default = atoi (value);
+		else if (!strcmp (name, "-swap-limit"))
+			swap_limit_default = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			ksm_pages = atoi (value);
+		else if (!strcmp (name, "-ksm-sleep"))
+			ksm_sleep = atoi (value);
+#endif
+#ifdef USERPROG
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
 #endif
@@ -326,8 +378,29 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -kmin=COUNT        Reserve at least COUNT pages for the kernel.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+			"  -umin=COUNT        Reserve at least COUNT pages for user memory.\n"
+			"  -no-pcid           Flush the TLB on every address space switch.\n"
+			"  -no-large          Map user memory with 4 kB pages only.\n"
+#endif
+#ifdef VM
+			"  -fault-around=PAGES Read PAGES pages around file page faults.\n"
+			"  -zswap=PERCENT     Keep swapped pages compressed in up to\n"
+			"                     PERCENT%% of kernel memory.\n"
+			"  -wmark-min=COUNT   Evict in the faulting thread below COUNT\n"
+			"                     free user frames.\n"
+			"  -wmark-low=COUNT   Wake the reclaim daemon below COUNT.\n"
+			"  -wmark-high=COUNT  Reclaim until COUNT frames are free.\n"
+			"  -writeback=TICKS   Write back dirty mapped pages every TICKS\n"
+			"                     timer ticks; 0 disables.\n"
+			"  -rss               Print resident set figures at process exit.\n"
+			"  -rss-limit=COUNT   Limit each process to COUNT frames.\n"
+			"  -swap-limit=COUNT  Limit each process to COUNT swap slots.\n"
+			"  -ksm=PAGES         Merge identical anonymous pages, scanning\n"
+			"                     PAGES frames per pass.\n"
+			"  -ksm-sleep=TICKS   Sleep TICKS timer ticks between passes.\n"
 #endif
 			);
 	power_off ();
@@ -354,6 +427,9 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
+	tlb_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -361,5 +437,10 @@ print_stats (void) {
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	syscall_print_stats ();
+	ring_print_stats ();
+#endif
+#ifdef VM
+	vm_print_stats ();
 #endif
 }
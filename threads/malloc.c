@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -25,8 +26,11 @@
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   blocks, we remove all of the arena's blocks from the free list.
+   The descriptor keeps one such empty arena as a spare, to use
+   the next time it needs a new arena, and gives any other back
+   to the page allocator.  Spares are given back too when the
+   page allocator runs short, through malloc_reclaim().
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
@@ -40,6 +44,12 @@ struct desc {
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	struct arena *spare;        /* Empty arena kept for reuse, or null. */
+
+	/* Statistics, protected by LOCK. */
+	size_t arena_cnt;           /* Arenas now allocated. */
+	size_t arena_peak;          /* Most arenas ever allocated at once. */
+	size_t used_cnt;            /* Blocks in use. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -61,8 +71,13 @@ struct block {
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Big blocks, updated with interrupts off. */
+static size_t big_cnt;          /* Big blocks in use. */
+static size_t big_pages;        /* Pages they occupy. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static size_t malloc_reclaim (enum palloc_flags, size_t page_cnt);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -76,7 +91,9 @@ malloc_init (void) {
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
 		list_init (&d->free_list);
 		lock_init (&d->lock);
+		d->spare = NULL;
 	}
+	palloc_register_reclaim (malloc_reclaim);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -100,7 +117,7 @@ malloc (size_t size) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-		a = palloc_get_multiple (0, page_cnt);
+		a = palloc_get_multiple (PAL_MALLOC, page_cnt);
 		if (a == NULL)
 			return NULL;
 
@@ -109,6 +126,11 @@ malloc (size_t size) {
 		a->magic = ARENA_MAGIC;
 		a->desc = NULL;
 		a->free_cnt = page_cnt;
+
+		enum intr_level old_level = intr_disable ();
+		big_cnt++;
+		big_pages += page_cnt;
+		intr_set_level (old_level);
 		return a + 1;
 	}
 
@@ -118,11 +140,17 @@ malloc (size_t size) {
 	if (list_empty (&d->free_list)) {
 		size_t i;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
+		/* Take the spare arena, if any, or else allocate a page. */
+		if (d->spare != NULL) {
+			a = d->spare;
+			d->spare = NULL;
+			d->arena_cnt--;
+		} else {
+			a = palloc_get_page (PAL_MALLOC);
+			if (a == NULL) {
+				lock_release (&d->lock);
+				return NULL;
+			}
 		}
 
 		/* Initialize arena and add its blocks to the free list. */
@@ -133,12 +161,15 @@ malloc (size_t size) {
 			struct block *b = arena_to_block (a, i);
 			list_push_back (&d->free_list, &b->free_elem);
 		}
+		if (++d->arena_cnt > d->arena_peak)
+			d->arena_peak = d->arena_cnt;
 	}
 
 	/* Get a block from free list and return it. */
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
 	a->free_cnt--;
+	d->used_cnt++;
 	lock_release (&d->lock);
 	return b;
 }
@@ -217,8 +248,10 @@ free (void *p) {
 
 			/* Add block to free list. */
 			list_push_front (&d->free_list, &b->free_elem);
+			d->used_cnt--;
 
-			/* If the arena is now entirely unused, free it. */
+			/* If the arena is now entirely unused, keep it as the
+			   spare or free it. */
 			if (++a->free_cnt >= d->blocks_per_arena) {
 				size_t i;
 
@@ -227,18 +260,71 @@ free (void *p) {
 					struct block *b = arena_to_block (a, i);
 					list_remove (&b->free_elem);
 				}
-				palloc_free_page (a);
+				if (d->spare == NULL)
+					d->spare = a;
+				else {
+					palloc_free_page (a);
+					d->arena_cnt--;
+				}
 			}
 
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
+			enum intr_level old_level = intr_disable ();
+			big_cnt--;
+			big_pages -= a->free_cnt;
+			intr_set_level (old_level);
 			palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
 
+/* Reclaim hook for palloc: gives the descriptors' spare arenas
+   back to the page allocator, up to PAGE_CNT of them, and returns
+   how many were given back.  Skips descriptors whose lock is
+   taken, since the caller may hold it while allocating a new
+   arena. */
+static size_t
+malloc_reclaim (enum palloc_flags flags UNUSED, size_t page_cnt) {
+	struct desc *d;
+	size_t freed = 0;
+
+	for (d = descs; d < descs + desc_cnt && freed < page_cnt; d++) {
+		if (lock_held_by_current_thread (&d->lock)
+				|| !lock_try_acquire (&d->lock))
+			continue;
+		if (d->spare != NULL) {
+			palloc_free_page (d->spare);
+			d->spare = NULL;
+			d->arena_cnt--;
+			freed++;
+		}
+		lock_release (&d->lock);
+	}
+	return freed;
+}
+
+/* Prints arena occupancy for each block size and the pages held
+   by big blocks.  May be called at any time; the numbers are not
+   taken atomically. */
+void
+malloc_print_stats (void) {
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt; d++) {
+		size_t blocks = d->arena_cnt * d->blocks_per_arena;
+		if (d->arena_peak == 0)
+			continue;
+		printf ("Malloc: %4zu-byte blocks: %zu of %zu in use (%zu%%), "
+				"%zu arenas, peak %zu\n", d->block_size, d->used_cnt, blocks,
+				blocks ? d->used_cnt * 100 / blocks : 0,
+				d->arena_cnt, d->arena_peak);
+	}
+	printf ("Malloc: %zu big blocks in %zu pages\n", big_cnt, big_pages);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
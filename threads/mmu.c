@@ -1,21 +1,71 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers (PCIDs).
+
+   When the CPU supports them, the TLB tags each translation with
+   the PCID that was in CR3 when it was cached, so switching
+   address spaces need not throw the TLB away.  Each pml4 that is
+   activated gets one of PCID_CNT identifiers; PCID 0 belongs to
+   base_pml4, which maps only the kernel.  Identifiers are recycled
+   least recently used first, and a recycled PCID is flushed when
+   it is loaded for its new owner.
+
+   Kernel mappings are marked global (PTE_G), so they survive even
+   a flushing CR3 load.
+
+   invlpg only affects the active PCID.  When a pml4 that is not
+   active is changed, its PCID is marked stale instead, and its TLB
+   entries are flushed the next time it is activated. */
+#define PCID_CNT 64                     /* Number of PCIDs in use. */
+#define CR3_PCID_MASK 0xfffULL          /* PCID field of CR3. */
+#define CR3_NOFLUSH (1ULL << 63)        /* Keep this PCID's TLB entries. */
+#define CR4_PGE (1 << 7)                /* Global pages enable. */
+#define CR4_PCIDE (1 << 17)             /* PCID enable. */
+#define CPUID_PGE (1 << 13)             /* CPUID.1:EDX, global pages. */
+#define CPUID_PCID (1 << 17)            /* CPUID.1:ECX, PCIDs. */
+
+/* A PCID and the pml4 it is assigned to. */
+struct pcid_slot {
+	uint64_t *pml4;                     /* Owner, or NULL if free. */
+	uint64_t last_use;                  /* Activation stamp, for LRU. */
+	bool stale;                         /* Flush on next activation? */
+};
+
+/* Indexed by PCID.  Slot 0 stands for base_pml4 and is not used. */
+static struct pcid_slot pcid_slots[PCID_CNT];
+static bool pcid_enabled;
+bool tlb_use_pcid = true;
+static uint64_t pcid_clock;
+
+/* Statistics. */
+static long long switch_keep_cnt;       /* Switches that kept the TLB. */
+static long long switch_flush_cnt;      /* Switches that flushed a PCID. */
+static long long pcid_recycle_cnt;      /* PCIDs taken from another pml4. */
+static long long gather_page_flush_cnt; /* Gathers flushed page by page. */
+static long long gather_full_flush_cnt; /* Gathers flushed all at once. */
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
+		/* A 2 MiB page has no page table below it; its PDE plays
+		   the role of the PTE. */
+		if (((uint64_t) pte & PTE_P) && ((uint64_t) pte & PTE_PS))
+			return &pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
+				uint64_t *new_page = palloc_get_page (PAL_ZERO | PAL_PGTABLE);
 				if (new_page)
 					pdp[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
 				else
@@ -37,7 +87,7 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 		uint64_t *pde = (uint64_t *) pdpe[idx];
 		if (!((uint64_t) pde & PTE_P)) {
 			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
+				uint64_t *new_page = palloc_get_page (PAL_ZERO | PAL_PGTABLE);
 				if (new_page) {
 					pdpe[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
 					allocated = 1;
@@ -60,7 +110,9 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a 2 MiB page, the page directory entry that
+ * maps it is returned instead; it has PTE_PS set. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -70,7 +122,7 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 		uint64_t *pdpe = (uint64_t *) pml4e[idx];
 		if (!((uint64_t) pdpe & PTE_P)) {
 			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
+				uint64_t *new_page = palloc_get_page (PAL_ZERO | PAL_PGTABLE);
 				if (new_page) {
 					pml4e[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
 					allocated = 1;
@@ -88,13 +140,44 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the table that entry IDX of TABLE points to.  If the
+ * entry is not present and CREATE is true, a new zeroed table is
+ * allocated for it; otherwise a null pointer is returned. */
+static uint64_t *
+next_table (uint64_t *table, int idx, int create) {
+	if (!(table[idx] & PTE_P)) {
+		uint64_t *new_page;
+		if (!create
+				|| (new_page = palloc_get_page (PAL_ZERO | PAL_PGTABLE)) == NULL)
+			return NULL;
+		table[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+	}
+	return ptov (PTE_ADDR (table[idx]));
+}
+
+/* Returns the address of the page directory entry for virtual
+ * address VA in PML4.  The entry may be empty, point to a page
+ * table, or map a 2 MiB page.  Missing upper level tables are
+ * created if CREATE is true; otherwise a null pointer is
+ * returned. */
+uint64_t *
+pml4_pde_walk (uint64_t *pml4, const uint64_t va, int create) {
+	uint64_t *pdpe, *pgdir;
+
+	if (pml4 == NULL
+			|| (pdpe = next_table (pml4, PML4 (va), create)) == NULL
+			|| (pgdir = next_table (pdpe, PDPE (va), create)) == NULL)
+		return NULL;
+	return &pgdir[PDX (va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
  * allocation fails. */
 uint64_t *
 pml4_create (void) {
-	uint64_t *pml4 = palloc_get_page (0);
+	uint64_t *pml4 = palloc_get_page (PAL_PGTABLE);
 	if (pml4)
 		memcpy (pml4, base_pml4, PGSIZE);
 	return pml4;
@@ -122,10 +205,18 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
-					pml4_index, pdp_index, i))
+		if (!(((uint64_t) pte) & PTE_P))
+			continue;
+		if (((uint64_t) pte) & PTE_PS) {
+			/* A 2 MiB page is visited once, through its PDE. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
 				return false;
+		} else if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
+					pml4_index, pdp_index, i))
+			return false;
 	}
 	return true;
 }
@@ -143,7 +234,8 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * A 2 MiB page is passed as its PDE, which has PTE_PS set. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -169,7 +261,11 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (!(((uint64_t) pte) & PTE_P))
+			continue;
+		if (((uint64_t) pte) & PTE_PS)
+			palloc_free_multiple ((void *) PTE_ADDR (pte), LARGE_PGCNT);
+		else
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -185,6 +281,69 @@ pdpe_destroy (uint64_t *pdpe) {
 	palloc_free_page ((void *) pdpe);
 }
 
+/* Returns the PCID slot assigned to PML4, or a null pointer.
+   Must be called with interrupts off. */
+static struct pcid_slot *
+pcid_lookup (const uint64_t *pml4) {
+	for (int i = 1; i < PCID_CNT; i++)
+		if (pcid_slots[i].pml4 == pml4)
+			return &pcid_slots[i];
+	return NULL;
+}
+
+/* Assigns a PCID to PML4, taking a free one or else the least
+   recently used one.  Must be called with interrupts off. */
+static struct pcid_slot *
+pcid_assign (uint64_t *pml4) {
+	struct pcid_slot *victim = &pcid_slots[1];
+
+	for (int i = 1; i < PCID_CNT; i++) {
+		struct pcid_slot *slot = &pcid_slots[i];
+		if (slot->pml4 == NULL) {
+			victim = slot;
+			break;
+		}
+		if (slot->last_use < victim->last_use)
+			victim = slot;
+	}
+	if (victim->pml4 != NULL)
+		pcid_recycle_cnt++;
+	victim->pml4 = pml4;
+	victim->stale = true;
+	return victim;
+}
+
+/* Returns true if PML4 is the active page map. */
+static bool
+is_active (const uint64_t *pml4) {
+	return PTE_ADDR (rcr3 ()) == vtop (pml4);
+}
+
+/* Makes sure no stale translation of VA in PML4 survives in the
+   TLB, either now or, if PML4 is not active, when it is next
+   activated. */
+static void
+tlb_invalidate (uint64_t *pml4, uint64_t va) {
+	if (is_active (pml4))
+		invlpg (va);
+	else if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		struct pcid_slot *slot = pcid_lookup (pml4);
+		if (slot != NULL)
+			slot->stale = true;
+		intr_set_level (old_level);
+	}
+}
+
+/* Like tlb_invalidate(), but for all of PML4's user mappings. */
+static void
+tlb_flush (uint64_t *pml4) {
+	if (is_active (pml4))
+		lcr3 (rcr3 ());
+	else
+		tlb_invalidate (pml4, 0);
+}
+
 /* Destroys pml4e, freeing all the pages it references. */
 void
 pml4_destroy (uint64_t *pml4) {
@@ -192,6 +351,14 @@ pml4_destroy (uint64_t *pml4) {
 		return;
 	ASSERT (pml4 != base_pml4);
 
+	if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		struct pcid_slot *slot = pcid_lookup (pml4);
+		if (slot != NULL)
+			slot->pml4 = NULL;
+		intr_set_level (old_level);
+	}
+
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
@@ -200,10 +367,118 @@ pml4_destroy (uint64_t *pml4) {
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries cached for PD are kept
+ * unless its PCID is new or stale. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	if (!pcid_enabled) {
+		lcr3 (vtop (pml4));
+		return;
+	}
+	if (pml4 == base_pml4) {
+		/* PCID 0 only ever holds kernel translations. */
+		lcr3 (vtop (pml4) | CR3_NOFLUSH);
+		return;
+	}
+
+	enum intr_level old_level = intr_disable ();
+	struct pcid_slot *slot = pcid_lookup (pml4);
+	uint64_t cr3;
+
+	if (slot == NULL)
+		slot = pcid_assign (pml4);
+	cr3 = vtop (pml4) | (uint64_t) (slot - pcid_slots);
+	if (slot->stale) {
+		slot->stale = false;
+		switch_flush_cnt++;
+	} else {
+		cr3 |= CR3_NOFLUSH;
+		switch_keep_cnt++;
+	}
+	slot->last_use = ++pcid_clock;
+	lcr3 (cr3);
+	intr_set_level (old_level);
+}
+
+/* Turns on global pages, so that kernel mappings (marked PTE_G)
+ * stay in the TLB across address space switches, and PCIDs, if
+ * the CPU has them and TLB_USE_PCID is set.  Called once
+ * base_pml4 is active. */
+void
+tlb_init (void) {
+	uint32_t a, b, c, d;
+
+	cpuid (1, &a, &b, &c, &d);
+	if (d & CPUID_PGE)
+		lcr4 (rcr4 () | CR4_PGE);
+	if (tlb_use_pcid && (c & CPUID_PCID)
+			&& (rcr3 () & CR3_PCID_MASK) == 0) {
+		lcr4 (rcr4 () | CR4_PCIDE);
+		pcid_enabled = true;
+	}
+}
+
+/* Prints TLB statistics. */
+void
+tlb_print_stats (void) {
+	if (pcid_enabled)
+		printf ("TLB: %lld switches kept the TLB, %lld flushed, "
+				"%lld PCIDs recycled\n",
+				switch_keep_cnt, switch_flush_cnt, pcid_recycle_cnt);
+	else
+		printf ("TLB: PCIDs %s\n", tlb_use_pcid ? "not supported" : "disabled");
+	printf ("TLB: %lld gathered flushes by page, %lld whole\n",
+			gather_page_flush_cnt, gather_full_flush_cnt);
+}
+
+/* The loader maps large enough BSS and data runs with 2 MiB
+ * pages, and so, under VM, does the first write fault on an
+ * untouched run of zero-fill anonymous pages.  Cleared by
+ * -no-large. */
+bool large_pages = true;
+
+/* Replaces PDE, which maps the 2 MiB user page containing VA in
+ * PML4, by a page table that maps the same frames with 4 kB pages,
+ * so that VA's page can be changed on its own.  Each new PTE takes
+ * the permissions and the accessed and dirty bits of the PDE.
+ * Returns VA's PTE, or a null pointer if memory runs out, in which
+ * case PDE is left as it was. */
+static uint64_t *
+split_large_page (uint64_t *pml4, uint64_t va, uint64_t *pde) {
+	uint64_t *pt;
+	uint64_t pa, flags;
+
+	ASSERT (is_user_vaddr (va));
+	ASSERT (*pde & PTE_PS);
+
+	pt = palloc_get_page (PAL_PGTABLE);
+	if (pt == NULL)
+		return NULL;
+	pa = PTE_ADDR (*pde);
+	flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	/* One invlpg drops the large page's TLB entry. */
+	tlb_invalidate (pml4, va);
+	return &pt[PTX (va)];
+}
+
+/* Returns the PTE for user virtual address VA in PML4, splitting
+ * the 2 MiB page VA lies in, if any.  If the split runs out of
+ * memory, returns the large page's PDE instead.  Returns a null
+ * pointer if VA has no page table. */
+static uint64_t *
+user_pte_walk (uint64_t *pml4, uint64_t va) {
+	uint64_t *pte = pml4e_walk (pml4, va, false);
+	uint64_t *small;
+
+	if (pte != NULL && (*pte & PTE_PS)
+			&& (small = split_large_page (pml4, va, pte)) != NULL)
+		pte = small;
+	return pte;
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -217,7 +492,8 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
 	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+		return ptov (PTE_ADDR (*pte))
+			+ (*pte & PTE_PS ? large_pg_ofs (uaddr) : pg_ofs (uaddr));
 	return NULL;
 }
 
@@ -227,6 +503,7 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
  * from the user pool with palloc_get_page().
  * If WRITABLE is true, the new page is read/write;
  * otherwise it is read-only.
+ * If UPAGE lies in a 2 MiB page, that page is split first.
  * Returns true if successful, false if memory allocation
  * failed. */
 bool
@@ -238,34 +515,155 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte && (*pte & PTE_PS))
+		pte = split_large_page (pml4, (uint64_t) upage, pte);
+	if (pte) {
+		bool was_present = (*pte & PTE_P) != 0;
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			tlb_invalidate (pml4, (uint64_t) upage);
+	}
 	return pte != NULL;
 }
 
+/* Adds a mapping in PML4 from the 2 MiB user region starting at
+ * UPAGE to the LARGE_PGCNT physically contiguous frames starting
+ * at kernel virtual address KPAGE, using a single page directory
+ * entry.  Both UPAGE and the physical address of KPAGE must be
+ * 2 MiB aligned; see palloc_get_large().  No page in the region
+ * may already be mapped.
+ * If WRITABLE is true, the new pages are read/write;
+ * otherwise they are read-only.
+ * Returns true if successful, false if memory allocation
+ * failed or part of the region is already mapped. */
+bool
+pml4_set_large_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT (large_pg_ofs (upage) == 0);
+	ASSERT (large_pg_ofs (vtop (kpage)) == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pml4_pde_walk (pml4, (uint64_t) upage, 1);
+	if (pde == NULL)
+		return false;
+
+	if (*pde & PTE_P) {
+		/* A page table may be replaced only if it maps nothing. */
+		uint64_t *pt = ptov (PTE_ADDR (*pde));
+		if (*pde & PTE_PS)
+			return false;
+		for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+			if (pt[i] & PTE_P)
+				return false;
+		*pde = 0;
+		palloc_free_page (pt);
+		/* Drop any cached translation through the old table. */
+		tlb_flush (pml4);
+	}
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
+ * UPAGE need not be mapped.  If UPAGE lies in a 2 MiB page, that
+ * page is split first, or, if memory for that runs out, the whole
+ * large page becomes not present. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
 	uint64_t *pte;
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
-	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	pte = user_pte_walk (pml4, (uint64_t) upage);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, (uint64_t) upage);
+	}
+}
+
+/* TLB gathering.
+
+   A page's stale TLB entry must be gone before its frame is
+   reused, but not necessarily the moment it is unmapped.  A caller
+   unmapping many pages can pass the same struct tlb_gather to
+   pml4_clear_page_gather() for each, and then flush them all with
+   one call to tlb_gather_flush(): by invlpg for up to
+   TLB_GATHER_MAX pages, otherwise by reloading CR3.  Once there
+   is more than one CPU, each flush is one shootdown rather than
+   one per page.  A gather covers one page map at a time; adding a
+   page from another flushes the pages gathered so far. */
+
+/* Initializes TLB as an empty gather. */
+void
+tlb_gather_init (struct tlb_gather *tlb) {
+	tlb->pml4 = NULL;
+	tlb->cnt = 0;
+	tlb->page_cnt = 0;
+	tlb->flush_cnt = 0;
+}
+
+/* Adds VA in PML4 to the pages TLB must flush. */
+static void
+tlb_gather_add (struct tlb_gather *tlb, uint64_t *pml4, uint64_t va) {
+	if (tlb->pml4 != pml4) {
+		tlb_gather_flush (tlb);
+		tlb->pml4 = pml4;
+	}
+	if (tlb->cnt < TLB_GATHER_MAX)
+		tlb->va[tlb->cnt] = va;
+	tlb->cnt++;
+	tlb->page_cnt++;
+}
+
+/* Flushes the TLB entries of the pages gathered in TLB since the
+   last flush, if any.  TLB may then gather more pages. */
+void
+tlb_gather_flush (struct tlb_gather *tlb) {
+	size_t i;
+
+	if (tlb->cnt == 0)
+		return;
+	if (tlb->cnt > TLB_GATHER_MAX || !is_active (tlb->pml4)) {
+		tlb_flush (tlb->pml4);
+		gather_full_flush_cnt++;
+	} else {
+		for (i = 0; i < tlb->cnt; i++)
+			invlpg (tlb->va[i]);
+		gather_page_flush_cnt++;
+	}
+	tlb->cnt = 0;
+	tlb->flush_cnt++;
+}
+
+/* Like pml4_clear_page(), but leaves flushing UPAGE's TLB entry
+ * to a later tlb_gather_flush() on TLB. */
+void
+pml4_clear_page_gather (uint64_t *pml4, void *upage, struct tlb_gather *tlb) {
+	uint64_t *pte;
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	pte = user_pte_walk (pml4, (uint64_t) upage);
+
+	if (pte != NULL && (*pte & PTE_P) != 0) {
+		*pte &= ~PTE_P;
+		tlb_gather_add (tlb, pml4, (uint64_t) upage);
 	}
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
- * Returns false if PML4 contains no PTE for VPAGE. */
+ * Returns false if PML4 contains no PTE for VPAGE.
+ * For a page inside a 2 MiB page, this and pml4_is_accessed()
+ * read the bits of the PDE, which cover the whole large page.
+ * Setting the dirty bit splits the large page first, as for
+ * pml4_clear_page(), so that the other pages stay dirty.  The
+ * accessed bit is only a hint, so pml4_set_accessed() sets or
+ * clears it in the PDE and leaves the large page whole. */
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
@@ -276,15 +674,14 @@ pml4_is_dirty (uint64_t *pml4, const void *vpage) {
  * in PML4. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = user_pte_walk (pml4, (uint64_t) vpage);
 	if (pte) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t) PTE_D;
+			*pte &= ~(uint64_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
 
@@ -299,7 +696,8 @@ pml4_is_accessed (uint64_t *pml4, const void *vpage) {
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  For a page inside a 2 MiB page, this sets the bit
+   for the whole large page. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
@@ -307,9 +705,8 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t) PTE_A;
+			*pte &= ~(uint64_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
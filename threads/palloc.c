@@ -8,7 +8,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -16,32 +18,133 @@
    page-multiple) chunks.  See malloc.h for an allocator that
    hands out smaller chunks.
 
-   System memory is divided into two "pools" called the kernel
-   and user pools.  The user pool is for user (virtual) memory
-   pages, the kernel pool for everything else.  The idea here is
-   that the kernel needs to have memory for its own operations
-   even if user processes are swapping like mad.
-
-   By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   All of physical memory is managed as one pool, but pages are
+   accounted to two classes of callers: user pages (PAL_USER),
+   which back user virtual memory, and kernel pages for
+   everything else.  Each class has a soft quota made of a
+   minimum reservation that the other class may never eat into,
+   plus a share of the memory above both reservations that goes
+   to whichever class asks for it first.  VM-heavy workloads can
+   therefore grow the user side while kernel pages sit idle, and
+   file system heavy ones can do the reverse.  The idea that the
+   kernel needs memory for its own operations even if user
+   processes are swapping like mad is kept by the kernel's
+   reservation.  User pages are additionally capped by -ul.
+
+   When a request cannot be satisfied, the allocator asks the
+   reclaim hooks registered with palloc_register_reclaim() to give
+   memory back, e.g. by evicting user frames or dropping cached
+   data, and then retries once.
+
+   Every allocation is also charged to an owner, named by one of
+   the owner flags in FLAGS (PAL_THREAD, PAL_PGTABLE, ...), so
+   that palloc_print_stats() can tell where memory goes.
+
+   The pool also remembers which of its free pages are already
+   filled with zeros.  The idle thread tops up that stock by
+   calling palloc_zero_idle(), which zeroes free pages from the
+   high end of the pool while the ordinary allocator keeps
+   scanning from the low end.  PAL_ZERO requests take a pre-zeroed
+   page when one is available and only fall back to zeroing the
+   page inline when the stock is empty. */
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct bitmap *zero_map;        /* Free pages known to be zeroed. */
+	uint8_t *owner_map;             /* Owner of each allocated page. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t free_cnt;                /* Number of free pages. */
+	size_t zero_cnt;                /* Number of bits set in zero_map. */
+	size_t zero_cursor;             /* Where the zeroing pass resumes. */
+
+	/* Statistics. */
+	long long zero_hits;            /* PAL_ZERO pages served pre-zeroed. */
+	long long zero_misses;          /* PAL_ZERO pages zeroed inline. */
+	long long zero_filled;          /* Pages zeroed by the idle pass. */
+};
+
+/* Page accounting for one class of callers. */
+struct quota {
+	size_t used;                    /* Pages currently allocated. */
+	size_t peak;                    /* High-water mark of USED. */
+	size_t reserve;                 /* Pages the other class can't take. */
+	size_t limit;                   /* Hard cap on USED. */
+	long long failures;             /* Requests that could not be met. */
 };
 
-/* Two pools: one for kernel data, one for user pages. */
-static struct pool kernel_pool, user_pool;
+/* Number of pre-zeroed pages the idle pass keeps in the pool. */
+#define ZERO_TARGET 256
+
+/* Number of pages the idle pass zeroes before it lets the idle
+   thread halt again. */
+#define ZERO_BATCH 8
+
+/* Page owners, for accounting.  An allocation belongs to the
+   first owner whose flag is set in its FLAGS, or else to OTHER. */
+enum owner {
+	OWNER_USER,
+	OWNER_THREAD,
+	OWNER_PGTABLE,
+	OWNER_MALLOC,
+	OWNER_PROCESS,
+	OWNER_FILESYS,
+	OWNER_VM,
+	OWNER_SYSTEM,
+	OWNER_OTHER,
+	OWNER_CNT
+};
+
+static const struct {
+	enum palloc_flags flag;
+	const char *name;
+} owner_info[OWNER_CNT] = {
+	[OWNER_USER] = { PAL_USER, "user" },
+	[OWNER_THREAD] = { PAL_THREAD, "thread" },
+	[OWNER_PGTABLE] = { PAL_PGTABLE, "page table" },
+	[OWNER_MALLOC] = { PAL_MALLOC, "malloc" },
+	[OWNER_PROCESS] = { PAL_PROCESS, "process" },
+	[OWNER_FILESYS] = { PAL_FILESYS, "file system" },
+	[OWNER_VM] = { PAL_VM, "vm" },
+	[OWNER_SYSTEM] = { PAL_SYSTEM, "system" },
+	[OWNER_OTHER] = { 0, "other" },
+};
+
+/* Current and peak number of pages per owner. */
+static size_t owner_pages[OWNER_CNT];
+static size_t owner_peak[OWNER_CNT];
+
+/* Maximum number of reclaim hooks. */
+#define RECLAIM_MAX 8
+
+/* All of physical memory, and the two classes it is split into. */
+static struct pool phys_pool;
+static struct quota kernel_quota, user_quota;
+
+/* Registered reclaim hooks, and the lock that serializes calls
+   to them. */
+static palloc_reclaim_func *reclaim_hooks[RECLAIM_MAX];
+static size_t reclaim_cnt;
+static struct lock reclaim_lock;
+static long long reclaim_passes;    /* # of times the hooks were run. */
+static long long reclaim_pages;     /* # of pages they gave back. */
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Minimum number of pages reserved for the kernel and for user
+   pages.  SIZE_MAX selects the default, an eighth of memory. */
+size_t kernel_page_reserve = SIZE_MAX;
+size_t user_page_reserve = SIZE_MAX;
+
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static enum owner flags_to_owner (enum palloc_flags);
+static bool zero_one_page (struct pool *);
+static void init_quotas (void);
 
 /* multiboot info */
 struct multiboot_info {
@@ -116,85 +219,28 @@ resolve_area_info (struct area *base_mem, struct area *ext_mem) {
 /*
  * Populate the pool.
  * All the pages are manged by this allocator, even include code page.
- * Basically, give half of memory to kernel, half to user.
- * We push base_mem portion to the kernel as much as possible.
+ * The pool spans from the lowest to the highest usable address;
+ * holes in the E820 map and the pages occupied by the kernel image
+ * and the pool's own bitmaps stay marked as used.
  */
 static void
 populate_pools (struct area *base_mem, struct area *ext_mem) {
 	extern char _end;
 	void *free_start = pg_round_up (&_end);
+	uint64_t pool_start = (uint64_t)
+		ptov (base_mem->size ? base_mem->start : ext_mem->start);
+	uint64_t pool_end = (uint64_t)
+		ptov (ext_mem->size ? ext_mem->end : base_mem->end);
 
-	uint64_t total_pages = (base_mem->size + ext_mem->size) / PGSIZE;
-	uint64_t user_pages = total_pages / 2 > user_page_limit ?
-		user_page_limit : total_pages / 2;
-	uint64_t kern_pages = total_pages - user_pages;
-
-	// Parse E820 map to claim the memory region for each pool.
-	enum { KERN_START, KERN, USER_START, USER } state = KERN_START;
-	uint64_t rem = kern_pages;
-	uint64_t region_start = 0, end = 0, start, size, size_in_pg;
+	init_pool (&phys_pool, &free_start,
+			(uint64_t) pg_round_down (pool_start), pool_end);
 
+	// Iterate over the e820_entry. Setup the usable.
 	struct multiboot_info *mb_info = ptov (MULTIBOOT_INFO);
 	struct e820_entry *entries = ptov (mb_info->mmap_base);
-
-	uint32_t i;
-	for (i = 0; i < mb_info->mmap_len / sizeof (struct e820_entry); i++) {
-		struct e820_entry *entry = &entries[i];
-		if (entry->type == ACPI_RECLAIMABLE || entry->type == USABLE) {
-			start = (uint64_t) ptov (APPEND_HILO (entry->mem_hi, entry->mem_lo));
-			size = APPEND_HILO (entry->len_hi, entry->len_lo);
-			end = start + size;
-			size_in_pg = size / PGSIZE;
-
-			if (state == KERN_START) {
-				region_start = start;
-				state = KERN;
-			}
-
-			switch (state) {
-				case KERN:
-					if (rem > size_in_pg) {
-						rem -= size_in_pg;
-						break;
-					}
-					// generate kernel pool
-					init_pool (&kernel_pool,
-							&free_start, region_start, start + rem * PGSIZE);
-					// Transition to the next state
-					if (rem == size_in_pg) {
-						rem = user_pages;
-						state = USER_START;
-					} else {
-						region_start = start + rem * PGSIZE;
-						rem = user_pages - size_in_pg + rem;
-						state = USER;
-					}
-					break;
-				case USER_START:
-					region_start = start;
-					state = USER;
-					break;
-				case USER:
-					if (rem > size_in_pg) {
-						rem -= size_in_pg;
-						break;
-					}
-					ASSERT (rem == size);
-					break;
-				default:
-					NOT_REACHED ();
-			}
-		}
-	}
-
-	// generate the user pool
-	init_pool(&user_pool, &free_start, region_start, end);
-
-	// Iterate over the e820_entry. Setup the usable.
 	uint64_t usable_bound = (uint64_t) free_start;
-	struct pool *pool;
-	void *pool_end;
-	size_t page_idx, page_cnt;
+	size_t pool_pages = bitmap_size (phys_pool.used_map);
+	uint32_t i;
 
 	for (i = 0; i < mb_info->mmap_len / sizeof (struct e820_entry); i++) {
 		struct e820_entry *entry = &entries[i];
@@ -211,27 +257,48 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 
 			start = (uint64_t)
 				pg_round_up (start >= usable_bound ? start : usable_bound);
-split:
-			if (page_from_pool (&kernel_pool, (void *) start))
-				pool = &kernel_pool;
-			else if (page_from_pool (&user_pool, (void *) start))
-				pool = &user_pool;
-			else
-				NOT_REACHED ();
-
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
-			page_idx = pg_no (start) - pg_no (pool->base);
-			if ((uint64_t) pool_end < end) {
-				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
-				start = (uint64_t) pool_end;
-				goto split;
-			} else {
-				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
-			}
+			end = (uint64_t) pg_round_down (end);
+			if (end <= start)
+				continue;
+
+			size_t page_idx = pg_no (start) - pg_no (phys_pool.base);
+			size_t page_cnt = (end - start) / PGSIZE;
+			if (page_idx >= pool_pages)
+				continue;
+			if (page_idx + page_cnt > pool_pages)
+				page_cnt = pool_pages - page_idx;
+			bitmap_set_multiple (phys_pool.used_map, page_idx, page_cnt, false);
 		}
 	}
+	phys_pool.free_cnt = bitmap_count (phys_pool.used_map, 0, pool_pages,
+			false);
+	init_quotas ();
+}
+
+/* Splits the free pages of the pool into the kernel and user
+   classes, honoring -ul, -kmin and -umin. */
+static void
+init_quotas (void) {
+	size_t total = phys_pool.free_cnt;
+
+	kernel_quota.limit = total;
+	user_quota.limit = user_page_limit < total ? user_page_limit : total;
+
+	kernel_quota.reserve = kernel_page_reserve != SIZE_MAX ?
+		kernel_page_reserve : total / 8;
+	user_quota.reserve = user_page_reserve != SIZE_MAX ?
+		user_page_reserve : total / 8;
+	if (user_quota.reserve > user_quota.limit)
+		user_quota.reserve = user_quota.limit;
+	if (kernel_quota.reserve > total)
+		kernel_quota.reserve = total;
+	if (kernel_quota.reserve + user_quota.reserve > total)
+		user_quota.reserve = total - kernel_quota.reserve;
+
+	lock_init (&reclaim_lock);
+	printf ("\tpages: %zu (kernel reserve %zu, user reserve %zu, "
+			"user limit %zu)\n", total, kernel_quota.reserve,
+			user_quota.reserve, user_quota.limit);
 }
 
 /* Initializes the page allocator and get the memory size */
@@ -253,19 +320,139 @@ palloc_init (void) {
 	return ext_mem.end;
 }
 
-/* Obtains and returns a group of PAGE_CNT contiguous free pages.
-   If PAL_USER is set, the pages are obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
-void *
-palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
-	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+/* Returns true if the class charged with quota Q may take
+   PAGE_CNT more pages out of POOL without exceeding its own limit
+   or eating into the unused reservation of the other class. */
+static bool
+quota_allows (const struct pool *pool, const struct quota *q,
+		size_t page_cnt) {
+	const struct quota *other = q == &user_quota ? &kernel_quota : &user_quota;
+	size_t other_unmet = other->reserve > other->used ?
+		other->reserve - other->used : 0;
+
+	return q->used + page_cnt <= q->limit
+		&& pool->free_cnt >= page_cnt + other_unmet;
+}
 
+/* Finds PAGE_CNT free pages in POOL whose physical address is a
+   multiple of ALIGN pages and marks them used.  Returns the index
+   of the first page, or BITMAP_ERROR.  POOL's lock must be held. */
+static size_t
+scan_aligned (struct pool *pool, size_t page_cnt, size_t align) {
+	size_t pool_pages = bitmap_size (pool->used_map);
+	size_t base_no = vtop (pool->base) / PGSIZE;
+	size_t idx;
+
+	for (idx = (align - base_no % align) % align;
+			idx + page_cnt <= pool_pages; idx += align)
+		if (bitmap_none (pool->used_map, idx, page_cnt)) {
+			bitmap_set_multiple (pool->used_map, idx, page_cnt, true);
+			return idx;
+		}
+	return BITMAP_ERROR;
+}
+
+/* Tries to allocate PAGE_CNT contiguous pages for FLAGS from
+   POOL, aligned to ALIGN pages.  Returns the index of the first
+   page, or BITMAP_ERROR.  Sets *ZEROED to whether all the pages
+   are known to be zero. */
+static size_t
+alloc_pages (struct pool *pool, enum palloc_flags flags, size_t page_cnt,
+		size_t align, bool *zeroed) {
+	struct quota *q = flags & PAL_USER ? &user_quota : &kernel_quota;
+	enum owner owner = flags_to_owner (flags);
+	size_t page_idx = BITMAP_ERROR;
+	enum intr_level old_level;
+
+	*zeroed = false;
 	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (!quota_allows (pool, q, page_cnt))
+		goto done;
+
+	/* A single zeroed page is the common case (thread stacks,
+	   page tables, user frames), so serve it from the stock of
+	   pre-zeroed pages first. */
+	if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zero_cnt > 0) {
+		page_idx = bitmap_scan (pool->zero_map, 0, 1, true);
+		if (page_idx != BITMAP_ERROR)
+			bitmap_mark (pool->used_map, page_idx);
+	}
+	if (page_idx == BITMAP_ERROR) {
+		if (align > 1)
+			page_idx = scan_aligned (pool, page_cnt, align);
+		else
+			page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	}
+	if (page_idx == BITMAP_ERROR)
+		goto done;
+
+	size_t zero_pages = bitmap_count (pool->zero_map, page_idx, page_cnt,
+			true);
+	*zeroed = zero_pages == page_cnt;
+	if (zero_pages > 0) {
+		bitmap_set_multiple (pool->zero_map, page_idx, page_cnt, false);
+		pool->zero_cnt -= zero_pages;
+	}
+	if (flags & PAL_ZERO) {
+		if (*zeroed)
+			pool->zero_hits += page_cnt;
+		else
+			pool->zero_misses += page_cnt;
+	}
+	memset (pool->owner_map + page_idx, owner, page_cnt);
+
+	/* palloc_free_multiple() updates the counters without the
+	   lock, so keep the update atomic. */
+	old_level = intr_disable ();
+	pool->free_cnt -= page_cnt;
+	q->used += page_cnt;
+	if (q->used > q->peak)
+		q->peak = q->used;
+	owner_pages[owner] += page_cnt;
+	if (owner_pages[owner] > owner_peak[owner])
+		owner_peak[owner] = owner_pages[owner];
+	intr_set_level (old_level);
+
+done:
 	lock_release (&pool->lock);
+	return page_idx;
+}
+
+/* Asks the reclaim hooks to give back at least PAGE_CNT pages
+   for a request made with FLAGS.  Returns true if any memory was
+   given back.  Hooks that themselves allocate memory do not
+   recurse into reclaim. */
+static bool
+run_reclaim (enum palloc_flags flags, size_t page_cnt) {
+	size_t freed = 0;
+	size_t i;
+
+	if (reclaim_cnt == 0 || intr_context ()
+			|| intr_get_level () == INTR_OFF
+			|| lock_held_by_current_thread (&reclaim_lock))
+		return false;
+
+	lock_acquire (&reclaim_lock);
+	reclaim_passes++;
+	for (i = 0; i < reclaim_cnt && freed < page_cnt; i++)
+		freed += reclaim_hooks[i] (flags, page_cnt - freed);
+	reclaim_pages += freed;
+	lock_release (&reclaim_lock);
+
+	return freed > 0;
+}
+
+/* Allocates PAGE_CNT contiguous pages aligned to ALIGN pages,
+   as described for palloc_get_multiple(). */
+static void *
+get_pages (enum palloc_flags flags, size_t page_cnt, size_t align) {
+	struct pool *pool = &phys_pool;
+	struct quota *q = flags & PAL_USER ? &user_quota : &kernel_quota;
+	bool zeroed;
+
+	size_t page_idx = alloc_pages (pool, flags, page_cnt, align, &zeroed);
+	if (page_idx == BITMAP_ERROR && run_reclaim (flags, page_cnt))
+		page_idx = alloc_pages (pool, flags, page_cnt, align, &zeroed);
 	void *pages;
 
 	if (page_idx != BITMAP_ERROR)
@@ -274,9 +461,14 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 		pages = NULL;
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
+		/* Outside the pool lock, so keep the update atomic
+		   against other failing callers. */
+		enum intr_level old_level = intr_disable ();
+		q->failures++;
+		intr_set_level (old_level);
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
 	}
@@ -284,6 +476,27 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	return pages;
 }
 
+/* Obtains and returns a group of PAGE_CNT contiguous free pages.
+   If PAL_USER is set, the pages are charged to the user class,
+   otherwise to the kernel class.  If PAL_ZERO is set in FLAGS,
+   then the pages are filled with zeros.  If too few pages are
+   available even after running the reclaim hooks, returns a null
+   pointer, unless PAL_ASSERT is set in FLAGS, in which case the
+   kernel panics. */
+void *
+palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
+	return get_pages (flags, page_cnt, 1);
+}
+
+/* Obtains LARGE_PGCNT contiguous pages whose physical address is
+   2 MiB aligned, suitable for mapping with a single large page
+   directory entry.  FLAGS are as for palloc_get_multiple().
+   Free the pages with palloc_free_multiple (..., LARGE_PGCNT). */
+void *
+palloc_get_large (enum palloc_flags flags) {
+	return get_pages (flags, LARGE_PGCNT, LARGE_PGCNT);
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -299,18 +512,17 @@ palloc_get_page (enum palloc_flags flags) {
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
-	struct pool *pool;
+	struct pool *pool = &phys_pool;
+	struct quota *q;
+	enum owner owner;
 	size_t page_idx;
+	enum intr_level old_level;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
 		return;
 
-	if (page_from_pool (&kernel_pool, pages))
-		pool = &kernel_pool;
-	else if (page_from_pool (&user_pool, pages))
-		pool = &user_pool;
-	else
+	if (!page_from_pool (pool, pages))
 		NOT_REACHED ();
 
 	page_idx = pg_no (pages) - pg_no (pool->base);
@@ -319,7 +531,20 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+
+	/* This may run with interrupts off from the scheduler, so it
+	   cannot take the pool lock.  Bitmap updates are atomic on a
+	   uniprocessor; the counters are updated with interrupts off. */
+	old_level = intr_disable ();
+	owner = pool->owner_map[page_idx];
+	q = owner == OWNER_USER ? &user_quota : &kernel_quota;
+	ASSERT (q->used >= page_cnt);
+	ASSERT (owner_pages[owner] >= page_cnt);
+	q->used -= page_cnt;
+	owner_pages[owner] -= page_cnt;
+	pool->free_cnt += page_cnt;
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +553,145 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Tops up the stock of pre-zeroed pages.  Called by the idle
+   thread with interrupts on; zeroes at most ZERO_BATCH pages and
+   returns true if there may be more work left.
+
+   The idle thread must never block, so the pool locks are only
+   ever tried, and interrupts stay off while a lock is held so
+   that the idle thread cannot be preempted with a pool lock in
+   hand. */
+bool
+palloc_zero_idle (void) {
+	struct pool *pool = &phys_pool;
+	size_t n;
+
+	for (n = 0; n < ZERO_BATCH; n++) {
+		enum intr_level old_level = intr_disable ();
+		bool zeroed = false;
+		if (pool->used_map != NULL && lock_try_acquire (&pool->lock)) {
+			zeroed = zero_one_page (pool);
+			lock_release (&pool->lock);
+		}
+		intr_set_level (old_level);
+		if (!zeroed)
+			return false;
+	}
+	return true;
+}
+
+/* Zeroes one free page of POOL that is not already known to be
+   zero, searching downward from the pool's zeroing cursor.
+   Returns false if the pool already holds ZERO_TARGET zeroed
+   pages or has no candidate.  POOL's lock must be held. */
+static bool
+zero_one_page (struct pool *pool) {
+	size_t page_cnt = bitmap_size (pool->used_map);
+	size_t scanned;
+
+	if (pool->zero_cnt >= ZERO_TARGET || page_cnt == 0)
+		return false;
+
+	for (scanned = 0; scanned < page_cnt; scanned++) {
+		size_t idx = pool->zero_cursor;
+		pool->zero_cursor = idx == 0 ? page_cnt - 1 : idx - 1;
+
+		if (!bitmap_test (pool->used_map, idx)
+				&& !bitmap_test (pool->zero_map, idx)) {
+			memset (pool->base + PGSIZE * idx, 0, PGSIZE);
+			bitmap_mark (pool->zero_map, idx);
+			pool->zero_cnt++;
+			pool->zero_filled++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Registers FUNC as a reclaim hook.  Hooks are called in
+   registration order, without any allocator lock held, when a
+   request cannot be satisfied. */
+void
+palloc_register_reclaim (palloc_reclaim_func *func) {
+	ASSERT (reclaim_cnt < RECLAIM_MAX);
+	reclaim_hooks[reclaim_cnt++] = func;
+}
+
+/* Returns the number of pages a request with FLAGS could still
+   take without running the reclaim hooks. */
+size_t
+palloc_free_pages (enum palloc_flags flags) {
+	const struct quota *q = flags & PAL_USER ? &user_quota : &kernel_quota;
+	const struct quota *other = q == &user_quota ? &kernel_quota : &user_quota;
+	size_t other_unmet = other->reserve > other->used ?
+		other->reserve - other->used : 0;
+	size_t avail = phys_pool.free_cnt > other_unmet ?
+		phys_pool.free_cnt - other_unmet : 0;
+	size_t headroom = q->limit > q->used ? q->limit - q->used : 0;
+
+	return avail < headroom ? avail : headroom;
+}
+
+/* Returns the owner that an allocation with FLAGS is charged to. */
+static enum owner
+flags_to_owner (enum palloc_flags flags) {
+	enum owner owner;
+
+	for (owner = 0; owner < OWNER_OTHER; owner++)
+		if (flags & owner_info[owner].flag)
+			break;
+	return owner;
+}
+
+/* Prints page allocator statistics, including how many pages
+   each owner holds now and held at most.  May be called at any
+   time. */
+void
+palloc_print_stats (void) {
+	struct pool *pool = &phys_pool;
+	long long total = pool->zero_hits + pool->zero_misses;
+	enum owner owner;
+
+	printf ("Palloc: kernel %zu pages (peak %zu, reserve %zu), "
+			"user %zu pages (peak %zu, reserve %zu), %zu free\n",
+			kernel_quota.used, kernel_quota.peak, kernel_quota.reserve,
+			user_quota.used, user_quota.peak, user_quota.reserve,
+			pool->free_cnt);
+	printf ("Palloc: %lld reclaim passes freed %lld pages, "
+			"%lld kernel and %lld user requests failed\n",
+			reclaim_passes, reclaim_pages,
+			kernel_quota.failures, user_quota.failures);
+	printf ("Palloc: %lld zeroed pages served, %lld pre-zeroed (%lld%%), "
+			"%lld zeroed while idle\n", total, pool->zero_hits,
+			total ? pool->zero_hits * 100 / total : 0, pool->zero_filled);
+	for (owner = 0; owner < OWNER_CNT; owner++)
+		printf ("Palloc: %-12s %6zu pages, peak %6zu\n",
+				owner_info[owner].name, owner_pages[owner], owner_peak[owner]);
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
+  /* We'll put the pool's used_map, zero_map and owner_map at
+     its base.  Calculate the space needed for them and subtract
+     it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
 
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	p->zero_map = bitmap_create_in_buf (pgcnt, *bm_base + bm_pages, bm_pages);
+	p->owner_map = *bm_base + bm_pages * 2;
 	p->base = (void *) start;
+	p->free_cnt = 0;
+	p->zero_cnt = 0;
+	p->zero_cursor = pgcnt ? pgcnt - 1 : 0;
 
-	// Mark all to unusable.
+	// Mark all to unusable, and nothing as known to be zero.
 	bitmap_set_all(p->used_map, true);
+	bitmap_set_all(p->zero_map, false);
 
-	*bm_base += bm_pages;
+	*bm_base += bm_pages * 2 + ROUND_UP (pgcnt, PGSIZE);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -233,7 +233,7 @@ thread_create (const char *name, int priority,
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = palloc_get_page (PAL_ZERO | PAL_THREAD);
 	if (t == NULL)
 		return TID_ERROR;
 
@@ -566,6 +566,12 @@ idle (void *idle_started_ UNUSED) {
 	sema_up (idle_started);
 
 	for (;;) {
+		/* Use otherwise wasted cycles to zero free pages, so that
+		   PAL_ZERO allocations do not have to.  Stop as soon as
+		   another thread becomes ready. */
+		if (list_empty (&ready_list) && palloc_zero_idle ())
+			continue;
+
 		/* Let someone else run. */
 		intr_disable ();
 		thread_block ();
@@ -620,6 +626,10 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->wait_on_lock = NULL;
 	list_init(&t->donations); // 연산자 우선순위에 따라 -> 먼저 실행
 
+#ifdef USERPROG
+	list_init (&t->rings);
+	list_init (&t->children);
+#endif
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
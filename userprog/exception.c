@@ -4,11 +4,19 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
 #include "intrinsic.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* Number of faulting user copies resumed at their fixup. */
+static long long fixup_cnt;
+
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
@@ -63,7 +71,15 @@ exception_init (void) {
 /* Prints exception statistics. */
 void
 exception_print_stats (void) {
-	printf ("Exception: %lld page faults\n", page_fault_cnt);
+#ifdef VM
+	long long major, minor;
+
+	vm_fault_counts (&major, &minor);
+	printf ("Exception: %lld major and %lld minor page faults handled\n",
+			major, minor);
+#endif
+	printf ("Exception: %lld page faults, %lld user copy faults fixed up\n",
+			page_fault_cnt, fixup_cnt);
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -146,6 +162,17 @@ page_fault (struct intr_frame *f) {
 		return;
 #endif
 
+	/* A kernel copy to or from a bad user address: make the copy
+	   fail instead of panicking. */
+	if (!user && is_user_vaddr (fault_addr)) {
+		uintptr_t fixup = uaccess_fixup (f->rip);
+		if (fixup != 0) {
+			fixup_cnt++;
+			f->rip = fixup;
+			return;
+		}
+	}
+
 	/* Count page faults. */
 	page_fault_cnt++;
 
@@ -0,0 +1,378 @@
+/* fd.c: Per-process file descriptor tables.
+ *
+ * Each process's table is an array of struct fd_entry indexed by
+ * descriptor, allocated on its first open.  An entry refers to an
+ * open file or to one end of a pipe.  Besides the owner's own
+ * system calls, the submission ring poller uses a process's table
+ * on its behalf, so every access is made under FILESYS_LOCK, which
+ * also serializes the file system itself. */
+
+#include "userprog/fd.h"
+#include <round.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "userprog/pipe.h"
+#include "userprog/uaccess.h"
+
+struct lock filesys_lock;
+
+/* What a descriptor refers to. */
+enum fd_type {
+	FD_FREE,                    /* Nothing: not open. */
+	FD_FILE,                    /* An open file. */
+	FD_PIPE_READ,               /* The read end of a pipe. */
+	FD_PIPE_WRITE               /* The write end of a pipe. */
+};
+
+/* An entry in a descriptor table. */
+struct fd_entry {
+	enum fd_type type;
+	union {
+		struct file *file;      /* FD_FILE. */
+		struct pipe *pipe;      /* FD_PIPE_READ, FD_PIPE_WRITE. */
+	};
+};
+
+/* Pages in a descriptor table. */
+#define FD_TABLE_PAGES DIV_ROUND_UP (FD_MAX * sizeof (struct fd_entry), PGSIZE)
+
+/* Bytes of file data moved per bounce through the kernel. */
+#define IO_CHUNK 512
+
+void
+fd_init (void) {
+	lock_init (&filesys_lock);
+}
+
+/* Returns T's entry for open descriptor FD, or NULL.  FILESYS_LOCK
+ * must be held. */
+static struct fd_entry *
+lookup (struct thread *t, int fd) {
+	if (t->fd_table == NULL || fd < FD_FIRST || fd >= FD_MAX
+			|| t->fd_table[fd].type == FD_FREE)
+		return NULL;
+	return &t->fd_table[fd];
+}
+
+/* Returns T's open file FD, or NULL if FD is not open or is a
+ * pipe.  FILESYS_LOCK must be held. */
+static struct file *
+lookup_file (struct thread *t, int fd) {
+	struct fd_entry *e = lookup (t, fd);
+
+	return e != NULL && e->type == FD_FILE ? e->file : NULL;
+}
+
+/* Returns T's lowest free descriptor, making T's table if it has
+ * none yet, or -EMFILE if the table is full, or -ENOMEM if out of
+ * memory.  FILESYS_LOCK must be held. */
+static int
+alloc_fd (struct thread *t) {
+	int fd;
+
+	if (t->fd_table == NULL) {
+		t->fd_table = palloc_get_multiple (PAL_ZERO | PAL_PROCESS,
+				FD_TABLE_PAGES);
+		if (t->fd_table == NULL)
+			return -ENOMEM;
+	}
+	for (fd = FD_FIRST; fd < FD_MAX; fd++)
+		if (t->fd_table[fd].type == FD_FREE)
+			return fd;
+	return -EMFILE;
+}
+
+/* Closes what E refers to and frees E.  FILESYS_LOCK must be
+ * held. */
+static void
+release (struct fd_entry *e) {
+	if (e->type == FD_FILE)
+		file_close (e->file);
+	else if (e->type != FD_FREE)
+		pipe_close (e->pipe, e->type == FD_PIPE_WRITE);
+	e->type = FD_FREE;
+}
+
+/* Opens file NAME for T.  Returns the new descriptor, or -ENOENT
+ * if there is no such file, -EMFILE if T's table is full, or
+ * -ENOMEM if out of memory. */
+int
+fd_open (struct thread *t, const char *name) {
+	struct file *file;
+	int fd;
+
+	lock_acquire (&filesys_lock);
+	fd = alloc_fd (t);
+	if (fd >= 0) {
+		if ((file = filesys_open (name)) == NULL)
+			fd = -ENOENT;
+		else
+			t->fd_table[fd] = (struct fd_entry) {
+				.type = FD_FILE, .file = file };
+	}
+	lock_release (&filesys_lock);
+	return fd;
+}
+
+/* Makes a pipe for T and stores descriptors for its read and write
+ * ends in FDS[0] and FDS[1].  Returns 0, or -EMFILE if T's table
+ * has no room for both, or -ENOMEM if out of memory. */
+int
+fd_pipe (struct thread *t, int fds[2]) {
+	struct pipe *pipe;
+	int error = 0;
+
+	lock_acquire (&filesys_lock);
+	pipe = pipe_create ();
+	if (pipe == NULL)
+		error = -ENOMEM;
+	else if ((fds[0] = alloc_fd (t)) < 0) {
+		error = fds[0];
+		pipe_close (pipe, false);
+		pipe_close (pipe, true);
+	} else {
+		t->fd_table[fds[0]] = (struct fd_entry) {
+			.type = FD_PIPE_READ, .pipe = pipe };
+		if ((fds[1] = alloc_fd (t)) < 0) {
+			error = fds[1];
+			release (&t->fd_table[fds[0]]);
+			pipe_close (pipe, true);
+		} else
+			t->fd_table[fds[1]] = (struct fd_entry) {
+				.type = FD_PIPE_WRITE, .pipe = pipe };
+	}
+	lock_release (&filesys_lock);
+	return error;
+}
+
+/* Closes T's descriptor FD.  Returns 0 or -EBADF. */
+int
+fd_close (struct thread *t, int fd) {
+	struct fd_entry *e;
+
+	lock_acquire (&filesys_lock);
+	e = lookup (t, fd);
+	if (e != NULL)
+		release (e);
+	lock_release (&filesys_lock);
+	return e != NULL ? 0 : -EBADF;
+}
+
+/* Closes all of T's descriptors and frees its table. */
+void
+fd_close_all (struct thread *t) {
+	int fd;
+
+	if (t->fd_table == NULL)
+		return;
+	lock_acquire (&filesys_lock);
+	for (fd = FD_FIRST; fd < FD_MAX; fd++)
+		release (&t->fd_table[fd]);
+	palloc_free_multiple (t->fd_table, FD_TABLE_PAGES);
+	t->fd_table = NULL;
+	lock_release (&filesys_lock);
+}
+
+/* Gives CHILD, which has no table yet, a copy of each of PARENT's
+ * descriptors under the same number: open files at the same
+ * position, and the same ends of the same pipes.  Returns false if
+ * out of memory, leaving CHILD with the copies made so far for
+ * fd_close_all(). */
+bool
+fd_copy_all (struct thread *child, struct thread *parent) {
+	bool success = true;
+	int fd;
+
+	if (parent->fd_table == NULL)
+		return true;
+	lock_acquire (&filesys_lock);
+	child->fd_table = palloc_get_multiple (PAL_ZERO | PAL_PROCESS,
+			FD_TABLE_PAGES);
+	if (child->fd_table == NULL)
+		success = false;
+	for (fd = FD_FIRST; success && fd < FD_MAX; fd++) {
+		struct fd_entry *e = &parent->fd_table[fd];
+		struct fd_entry *c = &child->fd_table[fd];
+
+		if (e->type == FD_FILE) {
+			c->file = file_duplicate (e->file);
+			success = c->file != NULL;
+			if (success)
+				c->type = FD_FILE;
+		} else if (e->type != FD_FREE) {
+			pipe_dup (e->pipe, e->type == FD_PIPE_WRITE);
+			*c = *e;
+		}
+	}
+	lock_release (&filesys_lock);
+	return success;
+}
+
+/* Returns true if FD is one of T's open descriptors. */
+bool
+fd_valid (struct thread *t, int fd) {
+	bool valid;
+
+	lock_acquire (&filesys_lock);
+	valid = lookup (t, fd) != NULL;
+	lock_release (&filesys_lock);
+	return valid;
+}
+
+/* Returns a new handle to T's file FD, for the caller to close,
+ * or NULL if FD is not an open file or memory runs out. */
+struct file *
+fd_reopen (struct thread *t, int fd) {
+	struct file *file;
+
+	lock_acquire (&filesys_lock);
+	file = lookup_file (t, fd);
+	if (file != NULL)
+		file = file_reopen (file);
+	lock_release (&filesys_lock);
+	return file;
+}
+
+/* Reads or writes, as WRITE says, up to SIZE bytes between pipe
+ * end E and user buffer UBUF.  A read waits for data and returns
+ * what there is, up to one chunk; a write waits for room until all
+ * of UBUF is written.  Returns the bytes moved, or -EBADF for the
+ * wrong end, -EPIPE if no one is left to read, or -EFAULT.
+ * FILESYS_LOCK must be held. */
+static long
+pipe_io (struct fd_entry *e, uint8_t *u, size_t size, bool write) {
+	uint8_t buf[IO_CHUNK];
+	size_t done = 0;
+	long n;
+
+	if (write != (e->type == FD_PIPE_WRITE))
+		return -EBADF;
+	if (!write) {
+		n = pipe_read (e->pipe, buf, size < IO_CHUNK ? size : IO_CHUNK);
+		if (n > 0 && copy_to_user (u, buf, n) != 0)
+			return -EFAULT;
+		return n;
+	}
+	while (done < size) {
+		size_t chunk = size - done < IO_CHUNK ? size - done : IO_CHUNK;
+
+		if (copy_from_user (buf, u + done, chunk) != 0)
+			return -EFAULT;
+		n = pipe_write (e->pipe, buf, chunk);
+		if (n < 0)
+			return done > 0 ? (long) done : n;
+		done += n;
+		if ((size_t) n < chunk)
+			break;
+	}
+	return done;
+}
+
+/* Reads or writes, as WRITE says, SIZE bytes between T's file FD
+ * and user buffer UBUF, in T's address space, which must be the
+ * active one.  Starts at offset OFS, or at the file position if
+ * OFS is negative, advancing it.  Returns the bytes moved, or
+ * -EBADF or -EFAULT.  After -EFAULT the file position is as it
+ * was, so the call may be retried as a whole; data written to the
+ * file before the fault stays written.
+ *
+ * FD may also be a pipe end, if OFS is negative (else -ESPIPE).
+ * Then the call may sleep, so only T itself may make it: the ring
+ * poller gets -EINVAL rather than stall its other rings. */
+long
+fd_io (struct thread *t, int fd, void *ubuf, size_t size, off_t ofs,
+		bool write) {
+	uint8_t buf[IO_CHUNK];
+	uint8_t *u = ubuf;
+	struct fd_entry *e;
+	struct file *file;
+	off_t start;
+	size_t done = 0;
+	long n;
+
+	lock_acquire (&filesys_lock);
+	e = lookup (t, fd);
+	if (e == NULL || e->type != FD_FILE) {
+		if (e == NULL)
+			n = -EBADF;
+		else if (ofs >= 0)
+			n = -ESPIPE;
+		else if (t != thread_current ())
+			n = -EINVAL;
+		else
+			n = pipe_io (e, u, size, write);
+		lock_release (&filesys_lock);
+		return n;
+	}
+	file = e->file;
+	start = file_tell (file);
+	while (done < size) {
+		size_t chunk = size - done < IO_CHUNK ? size - done : IO_CHUNK;
+		off_t n;
+
+		if (write) {
+			if (copy_from_user (buf, u + done, chunk) != 0)
+				goto fault;
+			n = ofs >= 0 ? file_write_at (file, buf, chunk, ofs + done)
+				: file_write (file, buf, chunk);
+		} else {
+			n = ofs >= 0 ? file_read_at (file, buf, chunk, ofs + done)
+				: file_read (file, buf, chunk);
+			if (n > 0 && copy_to_user (u + done, buf, n) != 0)
+				goto fault;
+		}
+		done += n;
+		if ((size_t) n < chunk)
+			break;
+	}
+	lock_release (&filesys_lock);
+	return done;
+
+fault:
+	file_seek (file, start);
+	lock_release (&filesys_lock);
+	return -EFAULT;
+}
+
+/* Returns the size of T's file FD, or -EBADF. */
+long
+fd_filesize (struct thread *t, int fd) {
+	struct file *file;
+	long size = -EBADF;
+
+	lock_acquire (&filesys_lock);
+	file = lookup_file (t, fd);
+	if (file != NULL)
+		size = file_length (file);
+	lock_release (&filesys_lock);
+	return size;
+}
+
+/* Sets the position of T's file FD to POS.  Returns 0 or -EBADF. */
+int
+fd_seek (struct thread *t, int fd, off_t pos) {
+	struct file *file;
+
+	lock_acquire (&filesys_lock);
+	file = lookup_file (t, fd);
+	if (file != NULL)
+		file_seek (file, pos);
+	lock_release (&filesys_lock);
+	return file != NULL ? 0 : -EBADF;
+}
+
+/* Returns the position of T's file FD, or -EBADF. */
+long
+fd_tell (struct thread *t, int fd) {
+	struct file *file;
+	long pos = -EBADF;
+
+	lock_acquire (&filesys_lock);
+	file = lookup_file (t, fd);
+	if (file != NULL)
+		pos = file_tell (file);
+	lock_release (&filesys_lock);
+	return pos;
+}
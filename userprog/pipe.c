@@ -0,0 +1,110 @@
+/* pipe.c: Pipes between processes.
+ *
+ * A pipe is a small ring buffer in kernel memory with a count of
+ * open descriptors for each end.  Readers sleep while it is empty
+ * and writers while it is full, so two processes can hand work
+ * back and forth without polling.  Pipes live in the descriptor
+ * tables, so like them they are only touched under FILESYS_LOCK,
+ * which the condition variables release while a caller sleeps. */
+
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <errno.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "userprog/fd.h"
+
+/* Bytes a pipe holds. */
+#define PIPE_SIZE 512
+
+struct pipe {
+	uint8_t buf[PIPE_SIZE];
+	size_t head;                /* Bytes ever read. */
+	size_t tail;                /* Bytes ever written. */
+	int readers;                /* Open read ends. */
+	int writers;                /* Open write ends. */
+	struct condition readable;  /* Signaled on write or last writer. */
+	struct condition writable;  /* Signaled on read or last reader. */
+};
+
+/* Returns a new pipe with one open end of each kind, or NULL if
+ * out of memory. */
+struct pipe *
+pipe_create (void) {
+	struct pipe *p = malloc (sizeof *p);
+
+	if (p == NULL)
+		return NULL;
+	p->head = p->tail = 0;
+	p->readers = p->writers = 1;
+	cond_init (&p->readable);
+	cond_init (&p->writable);
+	return p;
+}
+
+/* Counts another open end of P, the write end if WRITE. */
+void
+pipe_dup (struct pipe *p, bool write) {
+	ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+	if (write)
+		p->writers++;
+	else
+		p->readers++;
+}
+
+/* Closes an end of P, the write end if WRITE, and frees P once
+ * both ends are closed.  Closing the last end of either kind wakes
+ * the other side: readers then see end of file, and writers fail. */
+void
+pipe_close (struct pipe *p, bool write) {
+	ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+	if (write && --p->writers == 0)
+		cond_broadcast (&p->readable, &filesys_lock);
+	else if (!write && --p->readers == 0)
+		cond_broadcast (&p->writable, &filesys_lock);
+	if (p->readers == 0 && p->writers == 0)
+		free (p);
+}
+
+/* Reads up to SIZE bytes from P into BUF, first waiting for P to
+ * hold some.  Returns the bytes read, or 0 at end of file. */
+long
+pipe_read (struct pipe *p, void *buf_, size_t size) {
+	uint8_t *buf = buf_;
+	size_t n;
+
+	ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+	while (p->head == p->tail && p->writers > 0 && size > 0)
+		cond_wait (&p->readable, &filesys_lock);
+	for (n = 0; n < size && p->head != p->tail; n++)
+		buf[n] = p->buf[p->head++ % PIPE_SIZE];
+	if (n > 0)
+		cond_broadcast (&p->writable, &filesys_lock);
+	return n;
+}
+
+/* Writes the SIZE bytes at BUF to P, waiting for room as needed.
+ * Returns SIZE, or, if P has no readers left, the bytes written
+ * before that was noticed or -EPIPE if none were. */
+long
+pipe_write (struct pipe *p, const void *buf_, size_t size) {
+	const uint8_t *buf = buf_;
+	size_t n = 0;
+
+	ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+	while (n < size && p->readers > 0) {
+		if (p->tail - p->head == PIPE_SIZE) {
+			cond_wait (&p->writable, &filesys_lock);
+			continue;
+		}
+		while (n < size && p->tail - p->head < PIPE_SIZE)
+			p->buf[p->tail++ % PIPE_SIZE] = buf[n++];
+		cond_broadcast (&p->readable, &filesys_lock);
+	}
+	return n > 0 || size == 0 ? (long) n : -EPIPE;
+}
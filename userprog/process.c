@@ -5,14 +5,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <timepage.h>
+#include "userprog/fd.h"
 #include "userprog/gdt.h"
+#include "userprog/ring.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "devices/timer.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -22,15 +27,66 @@
 #include "vm/vm.h"
 #endif
 
+/* What a new process's thread starts from. */
+struct process_start {
+	struct child *child;            /* Record shared with the parent. */
+	char *cmd_line;                 /* initd: command line to run. */
+	struct thread *parent;          /* fork: process being copied. */
+	struct intr_frame *parent_if;   /* fork: its user context. */
+	struct semaphore done;          /* fork: upped when copying ends. */
+	bool success;                   /* fork: whether the copy worked. */
+};
+
 static void process_cleanup (void);
-static bool load (const char *file_name, struct intr_frame *if_);
-static void initd (void *f_name);
+static bool load (char *cmd_line, struct intr_frame *if_);
+static void initd (void *aux);
 static void __do_fork (void *);
+static bool map_time_page (uint64_t *pml4);
 
-/* General process initializer for initd and other process. */
+/* General process initializer for initd and other process.
+ * CHILD is the record shared with the parent. */
 static void
-process_init (void) {
+process_init (struct child *child) {
 	struct thread *current = thread_current ();
+
+	current->child = child;
+	current->exit_status = -1;
+}
+
+/* Drops one reference to C, freeing it with the last. */
+static void
+child_release (struct child *c) {
+	enum intr_level old_level = intr_disable ();
+	bool last = --c->ref_cnt == 0;
+	intr_set_level (old_level);
+
+	if (last)
+		free (c);
+}
+
+/* Starts thread NAME running FUNC on START, as a child of the
+ * current thread.  Returns its thread id, or TID_ERROR. */
+static tid_t
+process_spawn (const char *name, thread_func *func,
+		struct process_start *start) {
+	struct child *c = malloc (sizeof *c);
+	tid_t tid;
+
+	if (c == NULL)
+		return TID_ERROR;
+	c->exit_status = -1;
+	sema_init (&c->exited, 0);
+	c->ref_cnt = 2;
+	start->child = c;
+
+	tid = thread_create (name, PRI_DEFAULT, func, start);
+	if (tid == TID_ERROR) {
+		free (c);
+		return TID_ERROR;
+	}
+	c->tid = tid;
+	list_push_back (&thread_current ()->children, &c->elem);
+	return tid;
 }
 
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
@@ -40,97 +96,170 @@ process_init (void) {
  * Notice that THIS SHOULD BE CALLED ONCE. */
 tid_t
 process_create_initd (const char *file_name) {
+	char name[sizeof thread_current ()->name];
+	struct process_start *start;
 	char *fn_copy;
 	tid_t tid;
 
 	/* Make a copy of FILE_NAME.
 	 * Otherwise there's a race between the caller and load(). */
-	fn_copy = palloc_get_page (0);
-	if (fn_copy == NULL)
-		return TID_ERROR;
+	fn_copy = palloc_get_page (PAL_PROCESS);
+	start = malloc (sizeof *start);
+	if (fn_copy == NULL || start == NULL)
+		goto error;
 	strlcpy (fn_copy, file_name, PGSIZE);
+	start->cmd_line = fn_copy;
+
+	/* The thread is named after the program, without its
+	 * arguments. */
+	strlcpy (name, file_name, sizeof name);
+	name[strcspn (name, " ")] = '\0';
 
 	/* Create a new thread to execute FILE_NAME. */
-	tid = thread_create (file_name, PRI_DEFAULT, initd, fn_copy);
+	tid = process_spawn (name, initd, start);
 	if (tid == TID_ERROR)
-		palloc_free_page (fn_copy);
+		goto error;
 	return tid;
+
+error:
+	if (fn_copy != NULL)
+		palloc_free_page (fn_copy);
+	free (start);
+	return TID_ERROR;
 }
 
 /* A thread function that launches first user process. */
 static void
-initd (void *f_name) {
+initd (void *aux) {
+	struct process_start *start = aux;
+	char *cmd_line = start->cmd_line;
+
+	process_init (start->child);
+	free (start);
 #ifdef VM
 	supplemental_page_table_init (&thread_current ()->spt);
 #endif
 
-	process_init ();
-
-	if (process_exec (f_name) < 0)
+	if (process_exec (cmd_line) < 0)
 		PANIC("Fail to launch initd\n");
 	NOT_REACHED ();
 }
 
 /* Clones the current process as `name`. Returns the new process's thread id, or
- * TID_ERROR if the thread cannot be created. */
+ * TID_ERROR if the thread cannot be created.  IF_ is the user context
+ * the child resumes from, with fork() returning 0.  Does not return
+ * until the child has finished copying the parent. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
+process_fork (const char *name, struct intr_frame *if_) {
+	struct process_start start;
+	tid_t tid;
+
+	start.parent = thread_current ();
+	start.parent_if = if_;
+	sema_init (&start.done, 0);
+	start.success = false;
+
 	/* Clone current thread to new thread.*/
-	return thread_create (name,
-			PRI_DEFAULT, __do_fork, thread_current ());
+	tid = process_spawn (name, __do_fork, &start);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+	sema_down (&start.done);
+	if (!start.success) {
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
+}
+
+/* Maps the shared time page read-only at TIME_PAGE in PML4.
+ * Returns true if successful, false if out of memory. */
+static bool
+map_time_page (uint64_t *pml4) {
+	return pml4_set_page (pml4, TIME_PAGE, timer_time_page (), false);
 }
 
 #ifndef VM
+/* Maps a copy of the page at KPAGE at VA in the current process,
+ * writable if WRITABLE.  Returns false if out of memory. */
+static bool
+copy_user_page (void *va, const void *kpage, bool writable) {
+	void *newpage = palloc_get_page (PAL_USER);
+
+	if (newpage == NULL)
+		return false;
+	memcpy (newpage, kpage, PGSIZE);
+	if (!pml4_set_page (thread_current ()->pml4, va, newpage, writable)) {
+		palloc_free_page (newpage);
+		return false;
+	}
+	return true;
+}
+
 /* Duplicate the parent's address space by passing this function to the
  * pml4_for_each. This is only for the project 2. */
 static bool
 duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	struct thread *current = thread_current ();
 	struct thread *parent = (struct thread *) aux;
-	void *parent_page;
+	uint8_t *parent_page;
 	void *newpage;
 	bool writable;
+	size_t i;
+
+	/* 1. Kernel pages are in every page table already. */
+	if (is_kernel_vaddr (va))
+		return true;
 
-	/* 1. TODO: If the parent_page is kernel page, then return immediately. */
+	/* The time page is shared, and already mapped in the child. */
+	if (va == TIME_PAGE)
+		return true;
 
 	/* 2. Resolve VA from the parent's page map level 4. */
 	parent_page = pml4_get_page (parent->pml4, va);
-
-	/* 3. TODO: Allocate new PAL_USER page for the child and set result to
-	 *    TODO: NEWPAGE. */
-
-	/* 4. TODO: Duplicate parent's page to the new page and
-	 *    TODO: check whether parent's page is writable or not (set WRITABLE
-	 *    TODO: according to the result). */
-
-	/* 5. Add new page to child's page table at address VA with WRITABLE
-	 *    permission. */
-	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
-		/* 6. TODO: if fail to insert page, do error handling. */
+	writable = is_writable (pte);
+	if (!is_large_pte (pte))
+		return copy_user_page (va, parent_page, writable);
+
+	/* A large page is copied into a large page when there is
+	 * contiguous memory for one, and into small pages otherwise. */
+	newpage = palloc_get_large (PAL_USER);
+	if (newpage != NULL) {
+		memcpy (newpage, parent_page, LARGE_PGSIZE);
+		if (pml4_set_large_page (current->pml4, va, newpage, writable))
+			return true;
+		palloc_free_multiple (newpage, LARGE_PGCNT);
 	}
+	for (i = 0; i < LARGE_PGCNT; i++)
+		if (!copy_user_page ((uint8_t *) va + i * PGSIZE,
+					parent_page + i * PGSIZE, writable))
+			return false;
 	return true;
 }
 #endif
 
 /* A thread function that copies parent's execution context.
- * Hint) parent->tf does not hold the userland context of the process.
- *       That is, you are required to pass second argument of process_fork to
- *       this function. */
+ * parent->tf does not hold the userland context of the process, so
+ * it comes from process_fork()'s IF_, through AUX.  The parent is
+ * blocked in process_fork() until START->DONE is upped, which keeps
+ * its resources, and AUX itself, steady while they are copied.
+ * Submission rings are not inherited. */
 static void
 __do_fork (void *aux) {
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+	struct process_start *start = aux;
+	struct thread *parent = start->parent;
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if;
-	bool succ = true;
 
-	/* 1. Read the cpu context to local stack. */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	process_init (start->child);
+
+	/* 1. Read the cpu context to local stack.  fork() returns 0
+	 *    in the child. */
+	memcpy (&if_, start->parent_if, sizeof (struct intr_frame));
+	if_.R.rax = 0;
 
 	/* 2. Duplicate PT */
 	current->pml4 = pml4_create();
-	if (current->pml4 == NULL)
+	if (current->pml4 == NULL || !map_time_page (current->pml4))
 		goto error;
 
 	process_activate (current);
@@ -143,18 +272,25 @@ __do_fork (void *aux) {
 		goto error;
 #endif
 
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
-
-	process_init ();
+	/* 3. Duplicate the open files, and the executable, which stays
+	 *    denied writes for as long as either process runs it. */
+	if (!fd_copy_all (current, parent))
+		goto error;
+	if (parent->exec_file != NULL) {
+		lock_acquire (&filesys_lock);
+		current->exec_file = file_duplicate (parent->exec_file);
+		lock_release (&filesys_lock);
+		if (current->exec_file == NULL)
+			goto error;
+	}
 
-	/* Finally, switch to the newly created process. */
-	if (succ)
-		do_iret (&if_);
+	/* Finally, let the parent go and switch to the newly created
+	 * process. */
+	start->success = true;
+	sema_up (&start->done);
+	do_iret (&if_);
 error:
+	sema_up (&start->done);
 	thread_exit ();
 }
 
@@ -162,7 +298,7 @@ error:
  * Returns -1 on fail. */
 int
 process_exec (void *f_name) {
-	char *file_name = f_name;
+	char *cmd_line = f_name;
 	bool success;
 
 	/* We cannot use the intr_frame in the thread structure.
@@ -177,10 +313,10 @@ process_exec (void *f_name) {
 	process_cleanup ();
 
 	/* And then load the binary */
-	success = load (file_name, &_if);
+	success = load (cmd_line, &_if);
 
 	/* If load failed, quit. */
-	palloc_free_page (file_name);
+	palloc_free_page (cmd_line);
 	if (!success)
 		return -1;
 
@@ -195,28 +331,52 @@ process_exec (void *f_name) {
  * exception), returns -1.  If TID is invalid or if it was not a
  * child of the calling process, or if process_wait() has already
  * been successfully called for the given TID, returns -1
- * immediately, without waiting.
- *
- * This function will be implemented in problem 2-2.  For now, it
- * does nothing. */
+ * immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED) {
-	/* XXX: Hint) The pintos exit if process_wait (initd), we recommend you
-	 * XXX:       to add infinite loop here before
-	 * XXX:       implementing the process_wait. */
+process_wait (tid_t child_tid) {
+	struct list *children = &thread_current ()->children;
+	struct list_elem *e;
+
+	for (e = list_begin (children); e != list_end (children);
+			e = list_next (e)) {
+		struct child *c = list_entry (e, struct child, elem);
+		int status;
+
+		if (c->tid != child_tid)
+			continue;
+		sema_down (&c->exited);
+		status = c->exit_status;
+		list_remove (e);
+		child_release (c);
+		return status;
+	}
 	return -1;
 }
 
-/* Exit the process. This function is called by thread_exit (). */
+/* Exit the process. This function is called by thread_exit ().
+ * Kernel threads have no parent record and leave quietly. */
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
-	/* TODO: Your code goes here.
-	 * TODO: Implement process termination message (see
-	 * TODO: project2/process_termination.html).
-	 * TODO: We recommend you to implement process resource cleanup here. */
+
+	if (curr->child != NULL)
+		printf ("%s: exit(%d)\n", curr->name, curr->exit_status);
 
 	process_cleanup ();
+	fd_close_all (curr);
+
+	/* Children never waited for are on their own now. */
+	while (!list_empty (&curr->children))
+		child_release (list_entry (list_pop_front (&curr->children),
+					struct child, elem));
+
+	/* Tell the parent last, once everything is released. */
+	if (curr->child != NULL) {
+		curr->child->exit_status = curr->exit_status;
+		sema_up (&curr->child->exited);
+		child_release (curr->child);
+		curr->child = NULL;
+	}
 }
 
 /* Free the current process's resources. */
@@ -224,6 +384,17 @@ static void
 process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
+	/* Stop the ring poller before the address space goes away. */
+	ring_destroy_all (curr);
+
+	/* Let the executable be written again. */
+	if (curr->exec_file != NULL) {
+		lock_acquire (&filesys_lock);
+		file_close (curr->exec_file);
+		lock_release (&filesys_lock);
+		curr->exec_file = NULL;
+	}
+
 #ifdef VM
 	supplemental_page_table_kill (&curr->spt);
 #endif
@@ -242,6 +413,7 @@ process_cleanup (void) {
 		 * that's been freed (and cleared). */
 		curr->pml4 = NULL;
 		pml4_activate (NULL);
+		pml4_clear_page (pml4, TIME_PAGE);
 		pml4_destroy (pml4);
 	}
 }
@@ -310,32 +482,54 @@ struct ELF64_PHDR {
 #define ELF ELF64_hdr
 #define Phdr ELF64_PHDR
 
+/* Most words a command line may pass to a program. */
+#define ARGC_MAX 64
+
 static bool setup_stack (struct intr_frame *if_);
+static bool push_args (struct intr_frame *if_, int argc, char *argv[]);
 static bool validate_segment (const struct Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
 		bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Loads the ELF executable named by the first word of CMD_LINE,
+ * which it splits into words in place, into the current thread,
+ * passing it the words as arguments.
  * Stores the executable's entry point into *RIP
  * and its initial stack pointer into *RSP.
  * Returns true if successful, false otherwise. */
 static bool
-load (const char *file_name, struct intr_frame *if_) {
+load (char *cmd_line, struct intr_frame *if_) {
 	struct thread *t = thread_current ();
+	char *argv[ARGC_MAX];
+	char *token, *save_ptr;
+	const char *file_name;
 	struct ELF ehdr;
 	struct file *file = NULL;
 	off_t file_ofs;
 	bool success = false;
+	int argc = 0;
 	int i;
 
+	/* Split the command line into words. */
+	for (token = strtok_r (cmd_line, " ", &save_ptr); token != NULL;
+			token = strtok_r (NULL, " ", &save_ptr)) {
+		if (argc == ARGC_MAX)
+			return false;
+		argv[argc++] = token;
+	}
+	if (argc == 0)
+		return false;
+	file_name = argv[0];
+
 	/* Allocate and activate page directory. */
 	t->pml4 = pml4_create ();
-	if (t->pml4 == NULL)
-		goto done;
+	if (t->pml4 == NULL || !map_time_page (t->pml4))
+		return false;
 	process_activate (thread_current ());
 
 	/* Open executable file. */
+	lock_acquire (&filesys_lock);
 	file = filesys_open (file_name);
 	if (file == NULL) {
 		printf ("load: %s: open failed\n", file_name);
@@ -414,17 +608,60 @@ load (const char *file_name, struct intr_frame *if_) {
 	/* Start address. */
 	if_->rip = ehdr.e_entry;
 
-	/* TODO: Your code goes here.
-	 * TODO: Implement argument passing (see project2/argument_passing.html). */
+	if (!push_args (if_, argc, argv))
+		goto done;
 
+	/* Keep the executable open, and unchanged, while it runs. */
+	file_deny_write (file);
+	t->exec_file = file;
 	success = true;
 
 done:
 	/* We arrive here whether the load is successful or not. */
-	file_close (file);
+	if (!success)
+		file_close (file);
+	lock_release (&filesys_lock);
 	return success;
 }
 
+/* Passes ARGC words ARGV to the new program as main()'s argc and
+ * argv: copies the strings to the top of its stack, with the argv
+ * array below them and a fake return address below that, as a
+ * call would leave it.  Returns false if they do not fit in the
+ * stack's first page. */
+static bool
+push_args (struct intr_frame *if_, int argc, char *argv[]) {
+	size_t len = 0;
+	char *str;
+	char **uargv;
+	uint64_t *ret;
+	int i;
+
+	for (i = 0; i < argc; i++)
+		len += strlen (argv[i]) + 1;
+	if (len + (argc + 3) * sizeof (char *) + 16 > PGSIZE)
+		return false;
+
+	str = (char *) (if_->rsp - len);
+	uargv = (char **) ROUND_DOWN ((uintptr_t) str - (argc + 1) * sizeof *uargv,
+			16);
+	ret = (uint64_t *) uargv - 1;
+	for (i = 0; i < argc; i++) {
+		size_t n = strlen (argv[i]) + 1;
+
+		memcpy (str, argv[i], n);
+		uargv[i] = str;
+		str += n;
+	}
+	uargv[argc] = NULL;
+	*ret = 0;
+
+	if_->rsp = (uintptr_t) ret;
+	if_->R.rdi = argc;
+	if_->R.rsi = (uintptr_t) uargv;
+	return true;
+}
+
 
 /* Checks whether PHDR describes a valid, loadable segment in
  * FILE and returns true if so, false otherwise. */
@@ -490,6 +727,10 @@ static bool install_page (void *upage, void *kpage, bool writable);
  * The pages initialized by this function must be writable by the
  * user process if WRITABLE is true, read-only otherwise.
  *
+ * Each 2 MiB aligned stretch that the segment covers completely,
+ * typically a large BSS, is mapped with a single large page when
+ * enough contiguous memory is available.
+ *
  * Return true if successful, false if a memory allocation error
  * or disk read error occurs. */
 static bool
@@ -501,6 +742,35 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 
 	file_seek (file, ofs);
 	while (read_bytes > 0 || zero_bytes > 0) {
+		if (large_pages && large_pg_ofs (upage) == 0
+				&& read_bytes + zero_bytes >= LARGE_PGSIZE) {
+			size_t large_read_bytes =
+				read_bytes < LARGE_PGSIZE ? read_bytes : LARGE_PGSIZE;
+			uint8_t *kpage = palloc_get_large (PAL_USER);
+
+			if (kpage != NULL) {
+				if (file_read (file, kpage, large_read_bytes)
+						!= (int) large_read_bytes) {
+					palloc_free_multiple (kpage, LARGE_PGCNT);
+					return false;
+				}
+				memset (kpage + large_read_bytes, 0,
+						LARGE_PGSIZE - large_read_bytes);
+
+				if (pml4_set_large_page (thread_current ()->pml4, upage, kpage,
+							writable)) {
+					read_bytes -= large_read_bytes;
+					zero_bytes -= LARGE_PGSIZE - large_read_bytes;
+					upage += LARGE_PGSIZE;
+					continue;
+				}
+
+				/* Fall back to small pages. */
+				palloc_free_multiple (kpage, LARGE_PGCNT);
+				file_seek (file, file_tell (file) - large_read_bytes);
+			}
+		}
+
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
 		 * and zero the final PAGE_ZERO_BYTES bytes. */
@@ -574,11 +844,15 @@ install_page (void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
+/* Reads PAGE's part of the segment from the struct file_load in
+ * AUX, which it consumes, on the first fault on PAGE. */
 static bool
 lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+	struct file_load *load = aux;
+	bool success = file_load_read (load, page->frame->kva);
+
+	file_load_free (load);
+	return success;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -609,13 +883,28 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
+		/* Read-only pages stay backed by the executable, so
+		 * eviction can drop them instead of swapping them out.
+		 * Writable ones become anonymous once loaded, and pages
+		 * with nothing to read are simply zero-filled. */
+		struct file_load *aux = NULL;
+		if (page_read_bytes > 0
+				&& (aux = file_load_new (file, ofs, page_read_bytes)) == NULL)
 			return false;
+		bool ok;
+		if (aux != NULL && !writable)
+			ok = vm_alloc_page_with_initializer (VM_FILE, upage, false,
+					NULL, aux);
+		else
+			ok = vm_alloc_page_with_initializer (VM_ANON, upage, writable,
+					aux != NULL ? lazy_load_segment : NULL, aux);
+		if (!ok) {
+			file_load_free (aux);
+			return false;
+		}
 
 		/* Advance. */
+		ofs += page_read_bytes;
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
@@ -629,11 +918,11 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
-
+	if (vm_alloc_page (VM_ANON | VM_STACK, stack_bottom, true)
+			&& vm_claim_page (stack_bottom)) {
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 	return success;
 }
 #endif /* VM */
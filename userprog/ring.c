@@ -0,0 +1,468 @@
+/* ring.c: Submission and completion rings.
+ *
+ * See ring.h for the interface seen by user processes.  The ring
+ * memory is allocated by the kernel and mapped into the process,
+ * outside the supplemental page table, so the kernel works on it
+ * through its own mapping and never faults on it.  Fields the
+ * process writes are read once into local variables, and the
+ * kernel keeps its own copies of the counters it owns.
+ *
+ * A ring's operations run either in its owner, in ring_enter(), or
+ * in the poller thread, for RING_SQPOLL rings.  The poller adopts
+ * the owner's page table while it runs them, so user buffers are
+ * reached with the same copy primitives either way.  But a page
+ * the poller finds missing cannot be faulted in, since that takes
+ * the owner's supplemental page table; instead the copy fails and
+ * the poller "punts" the operation to the owner, which runs it in
+ * its next ring_enter().  Operations that fail on a fault leave
+ * no effect that rerunning them would repeat. */
+
+#include "userprog/ring.h"
+#include <debug.h>
+#include <list.h>
+#include <ring.h>
+#include <round.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/fd.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Result of an operation the poller must leave to the owner. */
+#define PUNT INT64_MIN
+
+/* Most rings per process. */
+#define RING_MAX 4
+
+/* A ring. */
+struct ring {
+	struct list_elem elem;      /* In the owner's RINGS. */
+	struct list_elem poll_elem; /* In POLL_LIST, if polled. */
+	int id;                     /* Identifier within the owner. */
+	struct thread *owner;       /* Process the ring belongs to. */
+	uint8_t *uaddr;             /* User address of the ring memory. */
+	size_t page_cnt;            /* Its size in pages. */
+	struct ring_hdr *hdr;       /* Kernel address of the ring memory. */
+	struct ring_sqe *sqes;
+	struct ring_cqe *cqes;
+	uint32_t entries;           /* Entries in each ring. */
+	bool sqpoll;                /* Polled? */
+
+	struct lock lock;           /* Held while running operations. */
+	struct condition done;      /* Signaled on completion or punt. */
+	uint32_t sq_head;           /* Kernel's copy of HDR->sq_head. */
+	uint32_t cq_tail;           /* Kernel's copy of HDR->cq_tail. */
+	struct list punted;         /* Operations left to the owner. */
+	size_t punted_cnt;          /* Number of them. */
+};
+
+/* An operation punted to the owner. */
+struct punted_sqe {
+	struct list_elem elem;
+	struct ring_sqe sqe;
+};
+
+/* Polled rings, and the poller thread.  POLL_LOCK is held for each
+ * pass of the poller over POLL_LIST, so a ring off the list is no
+ * longer in use by the poller. */
+static struct list poll_list;
+static struct lock poll_lock;
+static struct semaphore poll_wakeup;    /* Upped to wake the poller. */
+static bool poller_started;
+static bool poller_asleep;
+int64_t ring_idle = TIMER_FREQ / 10;
+
+/* Statistics. */
+static long long op_cnt;            /* Operations run. */
+static long long poll_op_cnt;       /* ...by the poller. */
+static long long punt_cnt;          /* Operations punted. */
+static long long wakeup_cnt;        /* Poller wakeups. */
+
+static void poller (void *aux);
+
+/* Returns the owner's ring ID, or NULL. */
+static struct ring *
+ring_lookup (struct thread *t, int id) {
+	struct list_elem *e;
+
+	for (e = list_begin (&t->rings); e != list_end (&t->rings);
+			e = list_next (e)) {
+		struct ring *r = list_entry (e, struct ring, elem);
+		if (r->id == id)
+			return r;
+	}
+	return NULL;
+}
+
+/* Returns true if no page in [ADDR, ADDR + PAGE_CNT pages) is in
+ * the current process's address space. */
+static bool
+range_free (uint8_t *addr, size_t page_cnt) {
+	struct thread *t = thread_current ();
+	size_t i;
+
+	if (page_cnt > ((uintptr_t) KERN_BASE - (uintptr_t) addr) / PGSIZE)
+		return false;
+	for (i = 0; i < page_cnt; i++) {
+		void *upage = addr + i * PGSIZE;
+		if (pml4_get_page (t->pml4, upage) != NULL)
+			return false;
+#ifdef VM
+		if (spt_find_page (&t->spt, upage) != NULL)
+			return false;
+#endif
+	}
+	return true;
+}
+
+/* Maps a ring of ENTRIES entries at ADDR in the current process,
+ * with RING_SQPOLL in FLAGS to have it polled.  Returns the ring's
+ * identifier, or -1 if ENTRIES is not a power of 2 up to
+ * RING_ENTRIES_MAX, ADDR is not page-aligned or the range is not
+ * free user memory, the process has RING_MAX rings, or memory
+ * runs out. */
+int
+ring_setup (void *addr, unsigned entries, int flags) {
+	struct thread *t = thread_current ();
+	struct ring *r;
+	size_t i;
+	int id;
+
+	if (entries == 0 || entries > RING_ENTRIES_MAX
+			|| (entries & (entries - 1)) != 0
+			|| addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| !range_free (addr, DIV_ROUND_UP (RING_SIZE (entries), PGSIZE)))
+		return -1;
+	for (id = 0; id < RING_MAX; id++)
+		if (ring_lookup (t, id) == NULL)
+			break;
+	if (id == RING_MAX || (r = calloc (1, sizeof *r)) == NULL)
+		return -1;
+
+	r->id = id;
+	r->owner = t;
+	r->uaddr = addr;
+	r->page_cnt = DIV_ROUND_UP (RING_SIZE (entries), PGSIZE);
+	r->hdr = palloc_get_multiple (PAL_PROCESS | PAL_ZERO, r->page_cnt);
+	if (r->hdr == NULL) {
+		free (r);
+		return -1;
+	}
+	for (i = 0; i < r->page_cnt; i++)
+		if (!pml4_set_page (t->pml4, r->uaddr + i * PGSIZE,
+					(uint8_t *) r->hdr + i * PGSIZE, true)) {
+			while (i-- > 0)
+				pml4_clear_page (t->pml4, r->uaddr + i * PGSIZE);
+			palloc_free_multiple (r->hdr, r->page_cnt);
+			free (r);
+			return -1;
+		}
+	r->hdr->entries = r->entries = entries;
+	r->sqes = RING_SQES (r->hdr);
+	r->cqes = RING_CQES (r->hdr, entries);
+	r->sqpoll = (flags & RING_SQPOLL) != 0;
+	lock_init (&r->lock);
+	cond_init (&r->done);
+	list_init (&r->punted);
+	list_push_back (&t->rings, &r->elem);
+
+	if (r->sqpoll) {
+		if (!poller_started) {
+			list_init (&poll_list);
+			lock_init (&poll_lock);
+			sema_init (&poll_wakeup, 0);
+			poller_started = true;
+			thread_create ("ringpoll", PRI_DEFAULT, poller, NULL);
+		}
+		lock_acquire (&poll_lock);
+		list_push_back (&poll_list, &r->poll_elem);
+		lock_release (&poll_lock);
+	}
+	return id;
+}
+
+/* Unmaps and frees R.  Must be called by its owner. */
+static void
+ring_destroy (struct ring *r) {
+	struct thread *t = thread_current ();
+	size_t i;
+
+	ASSERT (r->owner == t);
+
+	if (r->sqpoll) {
+		lock_acquire (&poll_lock);
+		list_remove (&r->poll_elem);
+		lock_release (&poll_lock);
+	}
+	while (!list_empty (&r->punted))
+		free (list_entry (list_pop_front (&r->punted), struct punted_sqe, elem));
+	for (i = 0; i < r->page_cnt; i++)
+		pml4_clear_page (t->pml4, r->uaddr + i * PGSIZE);
+	palloc_free_multiple (r->hdr, r->page_cnt);
+	list_remove (&r->elem);
+	free (r);
+}
+
+/* Destroys all of T's rings.  Called before its page table is. */
+void
+ring_destroy_all (struct thread *t) {
+	while (!list_empty (&t->rings))
+		ring_destroy (list_entry (list_front (&t->rings), struct ring, elem));
+}
+
+/* Runs SQE for R's owner.  Returns its result, or PUNT if it must
+ * be run by the owner and the caller is not the owner. */
+static int64_t
+ring_run (struct ring *r, const struct ring_sqe *sqe) {
+	bool owner = thread_current () == r->owner;
+	char name[FD_NAME_MAX + 1];
+	int64_t res;
+	long len;
+
+	switch (sqe->op) {
+		case RING_OP_NOP:
+			res = 0;
+			break;
+		case RING_OP_READ:
+		case RING_OP_WRITE:
+			res = fd_io (r->owner, sqe->fd, (void *) sqe->addr, sqe->len,
+					sqe->off < 0 ? -1 : sqe->off, sqe->op == RING_OP_WRITE);
+			break;
+		case RING_OP_OPEN:
+			len = strncpy_from_user (name, (const char *) sqe->addr, sizeof name);
+			if (len < 0)
+				res = len;
+			else if ((size_t) len == sizeof name)
+				res = -ENAMETOOLONG;
+			else
+				res = fd_open (r->owner, name);
+			break;
+		case RING_OP_CLOSE:
+			res = fd_close (r->owner, sqe->fd);
+			break;
+		case RING_OP_FSYNC:
+			/* Writes go straight to disk. */
+			res = fd_valid (r->owner, sqe->fd) ? 0 : -EBADF;
+			break;
+		default:
+			res = -EINVAL;
+			break;
+	}
+	if (res == -EFAULT && !owner)
+		return PUNT;
+	op_cnt++;
+	if (!owner)
+		poll_op_cnt++;
+	return res;
+}
+
+/* Posts a completion of USER_DATA with RES to R. */
+static void
+ring_post (struct ring *r, uint64_t user_data, int64_t res) {
+	struct ring_cqe *cqe = &r->cqes[r->cq_tail & (r->entries - 1)];
+
+	cqe->user_data = user_data;
+	cqe->res = res;
+	barrier ();
+	r->hdr->cq_tail = ++r->cq_tail;
+}
+
+/* Returns the number of CQEs R's owner has yet to take. */
+static uint32_t
+ring_ready (struct ring *r) {
+	uint32_t ready = r->cq_tail - *(volatile uint32_t *) &r->hdr->cq_head;
+
+	/* A corrupt head reads as a full ring. */
+	return ready <= r->entries ? ready : r->entries;
+}
+
+/* Returns the number of SQEs queued in R and not yet taken. */
+static uint32_t
+ring_pending (struct ring *r) {
+	uint32_t pending = *(volatile uint32_t *) &r->hdr->sq_tail - r->sq_head;
+
+	return pending <= r->entries ? pending : 0;
+}
+
+/* Returns true if R has queued SQEs and room for their results. */
+static bool
+ring_runnable (struct ring *r) {
+	return ring_pending (r) > 0 && ring_ready (r) + r->punted_cnt < r->entries;
+}
+
+/* Takes up to MAX queued SQEs from R and runs them, as far as the
+ * completion ring has room for their results.  Returns the number
+ * taken.  R's lock must be held. */
+static uint32_t
+ring_consume (struct ring *r, uint32_t max) {
+	uint32_t taken = 0;
+
+	while (taken < max && ring_runnable (r)) {
+		struct ring_sqe sqe = r->sqes[r->sq_head & (r->entries - 1)];
+		int64_t res;
+
+		barrier ();
+		r->hdr->sq_head = ++r->sq_head;
+		taken++;
+
+		res = ring_run (r, &sqe);
+		if (res == PUNT) {
+			struct punted_sqe *p = malloc (sizeof *p);
+			if (p == NULL)
+				ring_post (r, sqe.user_data, -ENOMEM);
+			else {
+				p->sqe = sqe;
+				list_push_back (&r->punted, &p->elem);
+				r->punted_cnt++;
+				punt_cnt++;
+			}
+		} else
+			ring_post (r, sqe.user_data, res);
+	}
+	return taken;
+}
+
+/* Runs the operations punted to R's owner, which must be the
+ * running thread.  R's lock must be held. */
+static void
+ring_run_punted (struct ring *r) {
+	while (!list_empty (&r->punted)) {
+		struct punted_sqe *p = list_entry (list_pop_front (&r->punted),
+				struct punted_sqe, elem);
+
+		r->punted_cnt--;
+		ring_post (r, p->sqe.user_data, ring_run (r, &p->sqe));
+		free (p);
+	}
+}
+
+/* Wakes the poller if it is asleep. */
+static void
+poller_wake (void) {
+	lock_acquire (&poll_lock);
+	if (poller_asleep) {
+		struct list_elem *e;
+
+		for (e = list_begin (&poll_list); e != list_end (&poll_list);
+				e = list_next (e))
+			list_entry (e, struct ring, poll_elem)->hdr->flags
+				&= ~RING_NEED_WAKEUP;
+		poller_asleep = false;
+		wakeup_cnt++;
+		sema_up (&poll_wakeup);
+	}
+	lock_release (&poll_lock);
+}
+
+/* Submits up to TO_SUBMIT queued operations on the current
+ * process's ring ID, unless the ring is polled, in which case the
+ * poller is woken if it is asleep.  Then waits for at least
+ * MIN_COMPLETE completions to be ready, or for as many as there is
+ * work outstanding and room for.  Returns the number of operations
+ * submitted, or -1 if there is no ring ID. */
+int
+ring_enter (int id, unsigned to_submit, unsigned min_complete) {
+	struct ring *r = ring_lookup (thread_current (), id);
+	int submitted = 0;
+
+	if (r == NULL)
+		return -1;
+	if (min_complete > r->entries)
+		min_complete = r->entries;
+	if (r->sqpoll && (r->hdr->flags & RING_NEED_WAKEUP))
+		poller_wake ();
+
+	lock_acquire (&r->lock);
+	ring_run_punted (r);
+	if (!r->sqpoll)
+		submitted = ring_consume (r, to_submit);
+	while (ring_ready (r) < min_complete && r->sqpoll
+			&& (ring_runnable (r) || r->punted_cnt > 0)) {
+		if (r->punted_cnt > 0)
+			ring_run_punted (r);
+		else
+			cond_wait (&r->done, &r->lock);
+	}
+	lock_release (&r->lock);
+	return r->sqpoll ? (int) to_submit : submitted;
+}
+
+/* Runs the queued operations of polled ring R, in its owner's
+ * address space.  Returns true if there were any. */
+static bool
+poll_ring (struct ring *r) {
+	struct thread *t = thread_current ();
+	uint32_t taken;
+
+	if (!ring_runnable (r))
+		return false;
+	lock_acquire (&r->lock);
+	t->pml4 = r->owner->pml4;
+	pml4_activate (t->pml4);
+	taken = ring_consume (r, r->entries);
+	t->pml4 = NULL;
+	pml4_activate (NULL);
+	if (taken > 0)
+		cond_broadcast (&r->done, &r->lock);
+	lock_release (&r->lock);
+	return taken > 0;
+}
+
+/* Poller thread.  Passes over the polled rings, yielding between
+ * passes, until none has had work for RING_IDLE ticks; then sets
+ * RING_NEED_WAKEUP in each and sleeps until ring_enter() or a new
+ * polled ring wakes it. */
+static void
+poller (void *aux UNUSED) {
+	int64_t idle_since = timer_ticks ();
+
+	for (;;) {
+		struct list_elem *e;
+		bool busy = false;
+
+		lock_acquire (&poll_lock);
+		for (e = list_begin (&poll_list); e != list_end (&poll_list);
+				e = list_next (e))
+			busy |= poll_ring (list_entry (e, struct ring, poll_elem));
+		if (busy)
+			idle_since = timer_ticks ();
+		else if (timer_elapsed (idle_since) >= ring_idle) {
+			/* Announce sleep, then look once more, so that an
+			 * operation queued meanwhile is not left waiting. */
+			for (e = list_begin (&poll_list); e != list_end (&poll_list);
+					e = list_next (e)) {
+				struct ring *r = list_entry (e, struct ring, poll_elem);
+				r->hdr->flags |= RING_NEED_WAKEUP;
+				barrier ();
+				busy |= ring_runnable (r);
+			}
+			if (!busy) {
+				poller_asleep = true;
+				lock_release (&poll_lock);
+				sema_down (&poll_wakeup);
+				idle_since = timer_ticks ();
+				continue;
+			}
+			for (e = list_begin (&poll_list); e != list_end (&poll_list);
+					e = list_next (e))
+				list_entry (e, struct ring, poll_elem)->hdr->flags
+					&= ~RING_NEED_WAKEUP;
+		}
+		lock_release (&poll_lock);
+		thread_yield ();
+	}
+}
+
+/* Prints ring statistics. */
+void
+ring_print_stats (void) {
+	printf ("Ring: %lld operations, %lld by the poller, %lld punted, "
+			"%lld poller wakeups\n", op_cnt, poll_op_cnt, punt_cnt, wakeup_cnt);
+}
@@ -1,12 +1,26 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
 #include <syscall-nr.h>
+#include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "userprog/fd.h"
 #include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "userprog/ring.h"
+#include "userprog/tss.h"
+#include "userprog/uaccess.h"
 #include "threads/flags.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
@@ -23,6 +37,78 @@ void syscall_handler (struct intr_frame *);
 #define MSR_STAR 0xc0000081         /* Segment selector msr */
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
+#define MSR_KERNEL_GS_BASE 0xc0000102 /* GS base swapped in by swapgs */
+
+/* Per-CPU data for syscall_entry, which reaches it through the GS
+ * base after swapgs, before it has a stack to work with.  The
+ * layout must match the offsets in syscall-entry.S.  Pintos runs
+ * on one CPU, so there is one of these. */
+struct syscall_cpu {
+	struct task_state *tss;     /* This CPU's TSS, for the kernel stack. */
+	uint64_t user_rsp;          /* Scratch: user rsp during entry. */
+};
+
+static struct syscall_cpu syscall_cpu;
+
+/* Most arguments a system call takes, in RDI, RSI, RDX, R10, R8
+ * and R9 in that order. */
+#define SYSCALL_ARG_MAX 6
+
+/* Handler for a system call, given its arguments.  Returns the
+ * value for RAX. */
+typedef uint64_t syscall_func (const uint64_t arg[SYSCALL_ARG_MAX]);
+
+/* An entry in the system call table. */
+struct syscall {
+	syscall_func *func;         /* Handler, or NULL if unimplemented. */
+	int argc;                   /* Arguments it takes; the rest are 0. */
+	const char *name;           /* Name, for statistics. */
+};
+
+static syscall_func sys_halt, sys_exit, sys_fork, sys_exec, sys_wait;
+static syscall_func sys_create, sys_remove, sys_open, sys_filesize;
+static syscall_func sys_read, sys_write, sys_seek, sys_tell, sys_close;
+static syscall_func sys_pipe;
+static syscall_func sys_null, sys_ticks, sys_ring_setup, sys_ring_enter;
+#ifdef VM
+static syscall_func sys_mmap, sys_munmap, sys_madvise, sys_msync, sys_setmemlimit;
+#endif
+
+/* System calls, indexed by SYS_* number. */
+static const struct syscall syscall_table[] = {
+	[SYS_HALT] = { sys_halt, 0, "halt" },
+	[SYS_EXIT] = { sys_exit, 1, "exit" },
+	[SYS_FORK] = { sys_fork, 1, "fork" },
+	[SYS_EXEC] = { sys_exec, 1, "exec" },
+	[SYS_WAIT] = { sys_wait, 1, "wait" },
+	[SYS_CREATE] = { sys_create, 2, "create" },
+	[SYS_REMOVE] = { sys_remove, 1, "remove" },
+	[SYS_OPEN] = { sys_open, 1, "open" },
+	[SYS_FILESIZE] = { sys_filesize, 1, "filesize" },
+	[SYS_READ] = { sys_read, 3, "read" },
+	[SYS_WRITE] = { sys_write, 3, "write" },
+	[SYS_SEEK] = { sys_seek, 2, "seek" },
+	[SYS_TELL] = { sys_tell, 1, "tell" },
+	[SYS_CLOSE] = { sys_close, 1, "close" },
+	[SYS_PIPE] = { sys_pipe, 1, "pipe" },
+#ifdef VM
+	[SYS_MMAP] = { sys_mmap, 6, "mmap" },
+	[SYS_MUNMAP] = { sys_munmap, 1, "munmap" },
+	[SYS_MADVISE] = { sys_madvise, 3, "madvise" },
+	[SYS_MSYNC] = { sys_msync, 3, "msync" },
+	[SYS_SETMEMLIMIT] = { sys_setmemlimit, 2, "setmemlimit" },
+#endif
+	[SYS_NULL] = { sys_null, 0, "null" },
+	[SYS_TICKS] = { sys_ticks, 0, "ticks" },
+	[SYS_RING_SETUP] = { sys_ring_setup, 3, "ring_setup" },
+	[SYS_RING_ENTER] = { sys_ring_enter, 3, "ring_enter" },
+};
+
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+/* Per-system call statistics. */
+static long long call_cnt[SYSCALL_CNT];     /* Calls made. */
+static uint64_t call_cycles[SYSCALL_CNT];   /* Cycles spent in them. */
 
 void
 syscall_init (void) {
@@ -35,12 +121,299 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	/* The kernel runs with a GS base of 0, and user programs never
+	 * change theirs, so the one swapped in is this CPU's data. */
+	syscall_cpu.tss = tss_get ();
+	write_msr(MSR_KERNEL_GS_BASE, (uint64_t) &syscall_cpu);
+
+	fd_init ();
 }
 
-/* The main system call interface */
+/* The main system call interface.  Looks the call up in
+ * syscall_table and passes it as many argument registers as it
+ * takes.  Unimplemented calls kill the process.  F stays in the
+ * thread's USER_IF for the duration, for fork(). */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: Your implementation goes here.
-	printf ("system call!\n");
+syscall_handler (struct intr_frame *f) {
+	struct thread *curr = thread_current ();
+	const uint64_t regs[SYSCALL_ARG_MAX] = {
+		f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10, f->R.r8, f->R.r9
+	};
+	uint64_t arg[SYSCALL_ARG_MAX] = { 0 };
+	uint64_t num = f->R.rax;
+	const struct syscall *sc;
+	uint64_t start;
+	int i;
+
+	if (num >= SYSCALL_CNT || syscall_table[num].func == NULL) {
+		printf ("system call!\n");
+		thread_exit ();
+	}
+	curr->user_if = f;
+	sc = &syscall_table[num];
+	for (i = 0; i < sc->argc; i++)
+		arg[i] = regs[i];
+
+	call_cnt[num]++;
+	start = rdtsc ();
+	f->R.rax = sc->func (arg);
+	call_cycles[num] += rdtsc () - start;
+	curr->user_if = NULL;
+}
+
+/* Prints the calls made to each system call and the cycles spent
+ * in them, including any time the caller was preempted. */
+void
+syscall_print_stats (void) {
+	size_t i;
+
+	for (i = 0; i < SYSCALL_CNT; i++)
+		if (call_cnt[i] > 0)
+			printf ("Syscall: %s: %lld calls, %llu cycles, %llu per call\n",
+					syscall_table[i].name, call_cnt[i],
+					(unsigned long long) call_cycles[i],
+					(unsigned long long) call_cycles[i] / call_cnt[i]);
+}
+
+/* Terminates the current process with exit code STATUS. */
+static void NO_RETURN
+exit_process (int status) {
+	thread_current ()->exit_status = status;
 	thread_exit ();
 }
+
+static uint64_t
+sys_halt (const uint64_t arg[] UNUSED) {
+	power_off ();
+}
+
+static uint64_t
+sys_exit (const uint64_t arg[]) {
+	exit_process ((int) arg[0]);
+}
+
+/* Copies the file name at user address UNAME into NAME, a buffer
+ * of FD_NAME_MAX + 1 bytes.  Returns false if it is too long.  A
+ * bad address kills the process. */
+static bool
+get_name (char *name, const char *uname) {
+	long len = strncpy_from_user (name, uname, FD_NAME_MAX + 1);
+
+	if (len < 0)
+		exit_process (-1);
+	return len <= FD_NAME_MAX;
+}
+
+static uint64_t
+sys_fork (const uint64_t arg[]) {
+	char name[FD_NAME_MAX + 1];
+
+	if (!get_name (name, (const char *) arg[0]))
+		return TID_ERROR;
+	return process_fork (name, thread_current ()->user_if);
+}
+
+/* Runs the command line at user address ARG[0] in place of the
+ * current program.  Returns only by killing the process, when the
+ * line is bad or the program cannot be loaded. */
+static uint64_t
+sys_exec (const uint64_t arg[]) {
+	char *cmd_line = palloc_get_page (PAL_PROCESS);
+	long len;
+
+	if (cmd_line == NULL)
+		exit_process (-1);
+	len = strncpy_from_user (cmd_line, (const char *) arg[0], PGSIZE);
+	if (len < 0 || len >= PGSIZE) {
+		palloc_free_page (cmd_line);
+		exit_process (-1);
+	}
+
+	/* Frees CMD_LINE, and the old program with it on success. */
+	process_exec (cmd_line);
+	exit_process (-1);
+}
+
+static uint64_t
+sys_wait (const uint64_t arg[]) {
+	return process_wait (arg[0]);
+}
+
+static uint64_t
+sys_create (const uint64_t arg[]) {
+	char name[FD_NAME_MAX + 1];
+	bool success;
+
+	if (!get_name (name, (const char *) arg[0]))
+		return false;
+	lock_acquire (&filesys_lock);
+	success = filesys_create (name, arg[1]);
+	lock_release (&filesys_lock);
+	return success;
+}
+
+static uint64_t
+sys_remove (const uint64_t arg[]) {
+	char name[FD_NAME_MAX + 1];
+	bool success;
+
+	if (!get_name (name, (const char *) arg[0]))
+		return false;
+	lock_acquire (&filesys_lock);
+	success = filesys_remove (name);
+	lock_release (&filesys_lock);
+	return success;
+}
+
+static uint64_t
+sys_open (const uint64_t arg[]) {
+	char name[FD_NAME_MAX + 1];
+	int fd;
+
+	if (!get_name (name, (const char *) arg[0]))
+		return -1;
+	fd = fd_open (thread_current (), name);
+	return fd >= 0 ? fd : -1;
+}
+
+static uint64_t
+sys_filesize (const uint64_t arg[]) {
+	long size = fd_filesize (thread_current (), arg[0]);
+
+	return size >= 0 ? size : -1;
+}
+
+/* Reads from or writes to file descriptor ARG[0].  A bad buffer
+ * kills the process. */
+static uint64_t
+file_io (const uint64_t arg[], bool write) {
+	long n = fd_io (thread_current (), arg[0], (void *) arg[1], (unsigned) arg[2],
+			-1, write);
+
+	if (n == -EFAULT)
+		exit_process (-1);
+	return n >= 0 ? n : -1;
+}
+
+static uint64_t
+sys_read (const uint64_t arg[]) {
+	return file_io (arg, false);
+}
+
+/* Writes to the console in chunks copied in from the user buffer,
+ * or to a file. */
+static uint64_t
+sys_write (const uint64_t arg[]) {
+	int fd = arg[0];
+	const char *ubuf = (const char *) arg[1];
+	unsigned size = arg[2], ofs;
+	char buf[256];
+
+	if (fd != 1)
+		return file_io (arg, true);
+	for (ofs = 0; ofs < size; ofs += sizeof buf) {
+		size_t chunk = size - ofs < sizeof buf ? size - ofs : sizeof buf;
+
+		if (copy_from_user (buf, ubuf + ofs, chunk) != 0)
+			exit_process (-1);
+		putbuf (buf, chunk);
+	}
+	return size;
+}
+
+static uint64_t
+sys_seek (const uint64_t arg[]) {
+	fd_seek (thread_current (), arg[0], arg[1]);
+	return 0;
+}
+
+static uint64_t
+sys_tell (const uint64_t arg[]) {
+	long pos = fd_tell (thread_current (), arg[0]);
+
+	return pos >= 0 ? pos : -1;
+}
+
+static uint64_t
+sys_close (const uint64_t arg[]) {
+	fd_close (thread_current (), arg[0]);
+	return 0;
+}
+
+/* Makes a pipe and stores its read and write descriptors in the
+ * two ints at user address ARG[0].  A bad address kills the
+ * process. */
+static uint64_t
+sys_pipe (const uint64_t arg[]) {
+	struct thread *curr = thread_current ();
+	int fds[2];
+
+	if (fd_pipe (curr, fds) < 0)
+		return -1;
+	if (copy_to_user ((void *) arg[0], fds, sizeof fds) != 0) {
+		fd_close (curr, fds[0]);
+		fd_close (curr, fds[1]);
+		exit_process (-1);
+	}
+	return 0;
+}
+
+static uint64_t
+sys_null (const uint64_t arg[] UNUSED) {
+	return 0;
+}
+
+static uint64_t
+sys_ticks (const uint64_t arg[] UNUSED) {
+	return timer_ticks ();
+}
+
+static uint64_t
+sys_ring_setup (const uint64_t arg[]) {
+	return ring_setup ((void *) arg[0], arg[1], arg[2]);
+}
+
+static uint64_t
+sys_ring_enter (const uint64_t arg[]) {
+	return ring_enter (arg[0], arg[1], arg[2]);
+}
+
+#ifdef VM
+/* Maps file ARG[3].  The mapping's pages read through handles of
+ * their own, so the descriptor may be closed at once. */
+static uint64_t
+sys_mmap (const uint64_t arg[]) {
+	struct file *file = fd_reopen (thread_current (), arg[3]);
+	void *addr;
+
+	if (file == NULL)
+		return 0;
+	addr = do_mmap ((void *) arg[0], arg[1], arg[2], arg[5], file, arg[4]);
+	lock_acquire (&filesys_lock);
+	file_close (file);
+	lock_release (&filesys_lock);
+	return (uint64_t) addr;
+}
+
+static uint64_t
+sys_munmap (const uint64_t arg[]) {
+	do_munmap ((void *) arg[0]);
+	return 0;
+}
+
+static uint64_t
+sys_madvise (const uint64_t arg[]) {
+	return vm_madvise ((void *) arg[0], arg[1], arg[2]) ? 0 : -1;
+}
+
+static uint64_t
+sys_msync (const uint64_t arg[]) {
+	return vm_msync ((void *) arg[0], arg[1], arg[2]) ? 0 : -1;
+}
+
+static uint64_t
+sys_setmemlimit (const uint64_t arg[]) {
+	return vm_set_limits (arg[0], arg[1]) ? 0 : -1;
+}
+#endif
@@ -2,5 +2,10 @@ userprog_SRC  = userprog/process.c	# Process loading.
 userprog_SRC += userprog/exception.c	# User exception handler.
 userprog_SRC += userprog/syscall-entry.S # System call entry.
 userprog_SRC += userprog/syscall.c	# System call handler.
+userprog_SRC += userprog/uaccess.c	# User memory access.
+userprog_SRC += userprog/uaccess-copy.S # User memory copy loops.
+userprog_SRC += userprog/fd.c		# File descriptor tables.
+userprog_SRC += userprog/pipe.c		# Pipes.
+userprog_SRC += userprog/ring.c		# Submission/completion rings.
 userprog_SRC += userprog/gdt.c		# GDT initialization.
 userprog_SRC += userprog/tss.c		# TSS management.
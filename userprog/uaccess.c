@@ -0,0 +1,88 @@
+/* uaccess.c: Copying to and from user memory.
+ *
+ * System calls copy their buffers and strings in and out of user
+ * memory with a plain bulk copy, rather than looking up each page
+ * in the page table first.  A page that is not yet loaded faults
+ * in the kernel and is brought in like a user fault would be.  A
+ * bad address that cannot be resolved faults too, and the page
+ * fault handler resumes the copy loop at its fixup, which makes
+ * the copy fail with -EFAULT.  The loops are in uaccess-copy.S.
+ *
+ * Addresses at or above KERN_BASE are rejected up front: the
+ * kernel can reach them, so they would not fault. */
+
+#include "userprog/uaccess.h"
+#include <stdbool.h>
+#include "threads/vaddr.h"
+
+size_t uaccess_copy (void *dst, const void *src, size_t size);
+long uaccess_strncpy (char *dst, const char *src, size_t size);
+
+/* Fixup table, in uaccess-copy.S: pairs of the address of an
+ * instruction that may fault on user memory and the address to
+ * resume at if it does. */
+extern const uintptr_t uaccess_fixups[], uaccess_fixups_end[];
+
+/* Returns true if [UADDR, UADDR + SIZE) lies in user memory. */
+static bool
+user_range_ok (const void *uaddr, size_t size) {
+	return is_user_vaddr (uaddr)
+		&& size <= (uintptr_t) KERN_BASE - (uintptr_t) uaddr;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns 0 if
+ * successful, -EFAULT if any of the source is not mapped readable
+ * user memory, in which case DST may have been partly written. */
+int
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	if (size == 0)
+		return 0;
+	if (!user_range_ok (usrc, size) || uaccess_copy (dst, usrc, size) != 0)
+		return -EFAULT;
+	return 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns 0 if
+ * successful, -EFAULT if any of the destination is not mapped
+ * writable user memory, in which case it may have been partly
+ * written. */
+int
+copy_to_user (void *udst, const void *src, size_t size) {
+	if (size == 0)
+		return 0;
+	if (!user_range_ok (udst, size) || uaccess_copy (udst, src, size) != 0)
+		return -EFAULT;
+	return 0;
+}
+
+/* Copies the null-terminated string at user address USRC to DST,
+ * a buffer of SIZE bytes.  Returns the string's length, not
+ * counting the null terminator, or SIZE if it does not fit, in
+ * which case DST is not null-terminated.  Returns -EFAULT if the
+ * string runs into memory that is not mapped readable. */
+long
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	size_t max;
+	long len;
+
+	if (!is_user_vaddr (usrc))
+		return -EFAULT;
+	max = (uintptr_t) KERN_BASE - (uintptr_t) usrc;
+	len = uaccess_strncpy (dst, usrc, size < max ? size : max);
+	if (len < 0 || ((size_t) len == max && max < size))
+		return -EFAULT;
+	return len;
+}
+
+/* If RIP is an instruction of the user copy loops that may fault,
+ * returns the address to resume at after a fault there.
+ * Otherwise, returns 0. */
+uintptr_t
+uaccess_fixup (uintptr_t rip) {
+	const uintptr_t *f;
+
+	for (f = uaccess_fixups; f < uaccess_fixups_end; f += 2)
+		if (f[0] == rip)
+			return f[1];
+	return 0;
+}
@@ -1,7 +1,15 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
+#include <mman.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/zswap.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,36 +25,291 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Number of sectors in a swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Slots reserved at a time for upcoming swap-outs, so that pages
+ * evicted together land next to each other on disk. */
+#define SWAP_CLUSTER 32
+
+/* Swap-in reads ahead the other slots of the aligned window of
+ * this many slots around the faulting one. */
+#define SWAP_READAHEAD 8
+
+/* Swap slots.  SWAP_MAP has one bit per page-sized slot of
+ * SWAP_DISK.  SLOT_PAGES maps each used slot back to a page
+ * stored there, and SLOT_REFS counts the pages referring to it,
+ * more than one if the page was shared copy-on-write.  Slots
+ * from CLUSTER_NEXT up to CLUSTER_END are free and reserved for
+ * the next swap-outs. */
+static struct bitmap *swap_map;
+static struct page **slot_pages;
+static unsigned short *slot_refs;
+static size_t cluster_next, cluster_end;
+static struct lock swap_lock;
+
+/* Swap statistics. */
+static size_t slots_used, slots_peak;
+static long long out_cnt;               /* Pages swapped out. */
+static long long disk_write_cnt;        /* Pages written to the disk. */
+static long long disk_read_cnt;         /* Pages read from the disk. */
+static long long out_run_cnt;           /* Runs of adjacent slots written. */
+static long long in_cnt;                /* Pages read on a fault. */
+static long long readahead_cnt;         /* Pages read ahead. */
+static size_t last_out_slot = BITMAP_ERROR;
+
+static void swap_readahead (struct page *page, size_t slot);
+static void swap_write (size_t slot, const void *kva);
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	size_t slot_cnt;
+
+	swap_disk = disk_get (1, 1);
+	slot_cnt = swap_disk != NULL ? disk_size (swap_disk) / SECTORS_PER_SLOT : 0;
+	swap_map = bitmap_create (slot_cnt);
+	slot_pages = calloc (slot_cnt, sizeof *slot_pages);
+	slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+	if (swap_map == NULL
+			|| (slot_cnt > 0 && (slot_pages == NULL || slot_refs == NULL)))
+		PANIC ("swap table creation failed");
+	cluster_next = cluster_end = 0;
+	lock_init (&swap_lock);
+	zswap_init (slot_cnt, swap_write);
+}
+
+/* Prints swap statistics. */
+void
+vm_anon_print_stats (void) {
+	printf ("Swap: %zu of %zu slots in use, peak %zu\n",
+			slots_used, bitmap_size (swap_map), slots_peak);
+	printf ("Swap: %lld pages out in %lld runs, %lld in, "
+			"%lld read ahead\n",
+			out_cnt, out_run_cnt, in_cnt, readahead_cnt);
+	printf ("Swap: %lld pages written to disk, %lld read\n",
+			disk_write_cnt, disk_read_cnt);
+	zswap_print_stats ();
+}
+
+/* Allocates a swap slot for PAGE and the REF_CNT - 1 other pages
+ * sharing its frame, taking the next slot of the current cluster
+ * and reserving a new cluster when it runs out.  Returns
+ * BITMAP_ERROR if swap is full. */
+static size_t
+swap_alloc (struct page *page, unsigned ref_cnt) {
+	size_t slot;
+
+	lock_acquire (&swap_lock);
+	if (cluster_next == cluster_end) {
+		/* Fall back to single slots once swap is too fragmented
+		 * for a whole cluster. */
+		size_t cnt = SWAP_CLUSTER;
+		size_t start = bitmap_scan (swap_map, 0, cnt, false);
+		if (start == BITMAP_ERROR) {
+			cnt = 1;
+			start = bitmap_scan (swap_map, 0, cnt, false);
+		}
+		if (start == BITMAP_ERROR) {
+			lock_release (&swap_lock);
+			return BITMAP_ERROR;
+		}
+		cluster_next = start;
+		cluster_end = start + cnt;
+	}
+	slot = cluster_next++;
+	bitmap_mark (swap_map, slot);
+	slot_pages[slot] = page;
+	slot_refs[slot] = ref_cnt;
+	if (++slots_used > slots_peak)
+		slots_peak = slots_used;
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Drops PAGE's reference to swap slot SLOT, freeing the slot
+ * when no page refers to it any more. */
+static void
+swap_free (size_t slot, struct page *page) {
+	lock_acquire (&swap_lock);
+	ASSERT (slot_refs[slot] > 0);
+	vm_swap_charge (page, -1);
+	if (slot_pages[slot] == page)
+		slot_pages[slot] = NULL;
+	if (--slot_refs[slot] == 0) {
+		bitmap_reset (swap_map, slot);
+		slot_pages[slot] = NULL;
+		slots_used--;
+		zswap_invalidate (slot);
+	}
+	lock_release (&swap_lock);
+}
+
+/* Reads swap slot SLOT into KVA, from the compressed pool if it
+ * is there, and drops PAGE's reference to it. */
+static void
+swap_read (size_t slot, struct page *page, void *kva) {
+	if (!zswap_load (slot, kva)) {
+		disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT, kva,
+				SECTORS_PER_SLOT);
+		disk_read_cnt++;
+	}
+	swap_free (slot, page);
+}
+
+/* Writes the page at KVA to swap slot SLOT on disk, as one disk
+ * request for the whole slot. */
+static void
+swap_write (size_t slot, const void *kva) {
+	disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT, kva,
+			SECTORS_PER_SLOT);
+	disk_write_cnt++;
+}
+
+/* Makes anonymous page DST, which has no frame, refer to the swap
+ * slot holding SRC, so that they share it copy-on-write. */
+void
+anon_share_slot (struct page *dst, struct page *src) {
+	size_t slot = src->anon.slot;
+
+	ASSERT (slot != BITMAP_ERROR);
+
+	lock_acquire (&swap_lock);
+	slot_refs[slot]++;
+	lock_release (&swap_lock);
+	dst->anon.slot = slot;
+	vm_swap_charge (dst, 1);
 }
 
 /* Initialize the file mapping */
 bool
-anon_initializer (struct page *page, enum vm_type type, void *kva) {
+anon_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = BITMAP_ERROR;
+	return true;
 }
 
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	size_t slot = anon_page->slot;
+
+	/* Never written: it was only ever on the zero frame. */
+	if (slot == BITMAP_ERROR) {
+		memset (kva, 0, PGSIZE);
+		return true;
+	}
+
+	swap_read (slot, page, kva);
+	anon_page->slot = BITMAP_ERROR;
+	if (page->frame->prefetched)
+		readahead_cnt++;
+	else if (page->advice != MADV_RANDOM) {
+		in_cnt++;
+		swap_readahead (page, slot);
+	}
+	return true;
+}
+
+/* Brings in the pages in the read-ahead window around SLOT that
+ * continue PAGE's virtual region in the same address space, that
+ * is, pages evicted together with it.  Stops at the first one
+ * that cannot get a free frame.
+ *
+ * A page in SLOT_PAGES may belong to another process, which can
+ * free it as soon as SWAP_LOCK is released, so it is only looked
+ * at under the lock.  A page that turns out to be PAGE's
+ * neighbour belongs to the faulting process, which cannot free it
+ * meanwhile. */
+static void
+swap_readahead (struct page *page, size_t slot) {
+	size_t start = slot / SWAP_READAHEAD * SWAP_READAHEAD;
+	size_t end = start + SWAP_READAHEAD;
+	size_t n;
+
+	if (end > bitmap_size (swap_map))
+		end = bitmap_size (swap_map);
+	for (n = start; n < end; n++) {
+		uint8_t *va = (uint8_t *) page->va
+			+ ((ptrdiff_t) n - (ptrdiff_t) slot) * PGSIZE;
+		struct page *p;
+
+		lock_acquire (&swap_lock);
+		p = slot_pages[n];
+		if (p != NULL && (p == page || p->pml4 != page->pml4 || p->va != va))
+			p = NULL;
+		lock_release (&swap_lock);
+
+		if (p != NULL && !vm_prefetch_page (p))
+			break;
+	}
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page by writing contents to the swap disk, or
+ * keeping them compressed in memory if they shrink enough.  The
+ * other pages sharing the frame, if any, share the slot. */
 static bool
 anon_swap_out (struct page *page) {
+	struct frame *frame = page->frame;
+	size_t slot = swap_alloc (page, frame->ref_cnt);
+	struct list_elem *e;
+
+	if (slot == BITMAP_ERROR)
+		return false;
+
+	if (!zswap_store (slot, frame->kva))
+		swap_write (slot, frame->kva);
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		p->anon.slot = slot;
+		vm_swap_charge (p, 1);
+	}
+
+	out_cnt++;
+	if (slot != last_out_slot + 1)
+		out_run_cnt++;
+	last_out_slot = slot;
+	return true;
+}
+
+/* Returns a checksum of the page of anonymous memory at KVA, for
+ * same-page merging to compare pages by. */
+uint64_t
+anon_checksum (const void *kva) {
+	const uint64_t *word = kva;
+	uint64_t sum = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < PGSIZE / sizeof *word; i++)
+		sum = (sum ^ word[i]) * 0x100000001b3ULL;
+	return sum;
+}
+
+/* Drops PAGE's contents, in memory and in swap, so that it reads
+ * as zeros the next time it is touched. */
+void
+anon_discard (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	vm_release_frame (page);
+	if (anon_page->slot != BITMAP_ERROR) {
+		swap_free (anon_page->slot, page);
+		anon_page->slot = BITMAP_ERROR;
+	}
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	vm_release_frame (page);
+	if (anon_page->slot != BITMAP_ERROR)
+		swap_free (anon_page->slot, page);
 }
@@ -1,6 +1,12 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include <mman.h>
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -19,40 +25,223 @@ void
 vm_file_init (void) {
 }
 
-/* Initialize the file backed page */
+/* Initialize the file backed page.  Takes over the struct
+ * file_load in the page's uninit aux and reads the contents into
+ * KVA, unless KVA is null because the caller already has. */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva) {
+	struct file_load *load = page->uninit.aux;
+
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->file = load->file;
+	file_page->ofs = load->ofs;
+	file_page->read_bytes = load->read_bytes;
+	free (load);
+	return kva != NULL ? file_backed_swap_in (page, kva) : true;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct file_load load = {
+		.file = file_page->file,
+		.ofs = file_page->ofs,
+		.read_bytes = file_page->read_bytes,
+	};
+
+	return file_load_read (&load, kva);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  A clean
+ * page is simply dropped.  Also used to clean a page that stays
+ * mapped, so the dirty bit is cleared before writing: a store that
+ * races with the write sets it again. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (pml4_is_dirty (page->pml4, page->va)) {
+		pml4_set_dirty (page->pml4, page->va, false);
+		file_write_at (file_page->file, page->frame->kva,
+				file_page->read_bytes, file_page->ofs);
+	}
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	vm_release_frame (page);
+	file_close (file_page->file);
 }
 
-/* Do the mmap */
+/* Returns a new description of READ_BYTES bytes of FILE at OFS,
+ * holding its own handle to FILE, or NULL if out of memory. */
+struct file_load *
+file_load_new (struct file *file, off_t ofs, size_t read_bytes) {
+	struct file_load *load = malloc (sizeof *load);
+
+	ASSERT (read_bytes <= PGSIZE);
+
+	if (load == NULL)
+		return NULL;
+	load->file = file_reopen (file);
+	if (load->file == NULL) {
+		free (load);
+		return NULL;
+	}
+	load->ofs = ofs;
+	load->read_bytes = read_bytes;
+	return load;
+}
+
+/* Returns a copy of LOAD with its own file handle, or NULL if
+ * out of memory. */
+struct file_load *
+file_load_dup (const struct file_load *load) {
+	return file_load_new (load->file, load->ofs, load->read_bytes);
+}
+
+/* Closes LOAD's file and frees it.  LOAD may be NULL. */
+void
+file_load_free (struct file_load *load) {
+	if (load != NULL) {
+		file_close (load->file);
+		free (load);
+	}
+}
+
+/* Reads the page described by LOAD into KVA and zeroes the rest
+ * of the page.  Returns true if successful. */
+bool
+file_load_read (const struct file_load *load, void *kva) {
+	if (file_read_at (load->file, kva, load->read_bytes, load->ofs)
+			!= (off_t) load->read_bytes)
+		return false;
+	memset ((uint8_t *) kva + load->read_bytes, 0, PGSIZE - load->read_bytes);
+	return true;
+}
+
+/* Do the mmap.
+ *
+ * Maps LENGTH bytes of FILE from OFFSET at ADDR, as lazily loaded
+ * file-backed pages; the part of the last page past the end of
+ * FILE reads as zeros.  FLAGS may include MAP_POPULATE to read the
+ * whole mapping in right away.  Each page holds its own handle to
+ * FILE, which the caller keeps.  Returns ADDR, or NULL if ADDR or
+ * OFFSET is not page-aligned or OFFSET is negative, FLAGS is
+ * unknown, the range is empty, outside user memory or overlaps
+ * existing pages, including kernel-mapped ones like the time page
+ * or a ring, FILE is empty, or memory runs out. */
 void *
-do_mmap (void *addr, size_t length, int writable,
+do_mmap (void *addr, size_t length, int writable, int flags,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct mmap_region *region;
+	uint8_t *upage = addr;
+	size_t page_cnt, i;
+	off_t file_len;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| offset < 0 || offset % PGSIZE != 0
+			|| (flags & ~MAP_POPULATE) != 0 || length == 0 || file == NULL
+			|| (file_len = file_length (file)) == 0)
+		return NULL;
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	if (page_cnt > ((uintptr_t) KERN_BASE - (uintptr_t) addr) / PGSIZE)
+		return NULL;
+	for (i = 0; i < page_cnt; i++)
+		if (spt_find_page (spt, upage + i * PGSIZE) != NULL
+				|| pml4_get_page (thread_current ()->pml4,
+					upage + i * PGSIZE) != NULL)
+			return NULL;
+
+	region = malloc (sizeof *region);
+	if (region == NULL)
+		return NULL;
+	for (i = 0; i < page_cnt; i++) {
+		off_t ofs = offset + i * PGSIZE;
+		size_t read_bytes = ofs >= file_len ? 0
+			: file_len - ofs < PGSIZE ? (size_t) (file_len - ofs) : PGSIZE;
+		struct file_load *load = file_load_new (file, ofs, read_bytes);
+
+		if (load == NULL
+				|| !vm_alloc_page_with_initializer (VM_FILE, upage + i * PGSIZE,
+					writable != 0, NULL, load)) {
+			file_load_free (load);
+			while (i-- > 0)
+				spt_remove_page (spt, spt_find_page (spt, upage + i * PGSIZE));
+			free (region);
+			return NULL;
+		}
+	}
+	region->addr = addr;
+	region->page_cnt = page_cnt;
+	list_push_back (&spt->mmaps, &region->elem);
+
+	if (flags & MAP_POPULATE)
+		vm_populate (upage, upage + page_cnt * PGSIZE, true);
+	return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap.  Unmaps the mapping that starts at ADDR, writing
+ * pages that were written back to the file, or does nothing if
+ * no mapping starts there. */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct list_elem *e;
+
+	for (e = list_begin (&spt->mmaps); e != list_end (&spt->mmaps);
+			e = list_next (e)) {
+		struct mmap_region *region = list_entry (e, struct mmap_region, elem);
+		size_t i;
+
+		if (region->addr != addr)
+			continue;
+		vm_unmap_range (addr, (uint8_t *) addr + region->page_cnt * PGSIZE);
+		for (i = 0; i < region->page_cnt; i++) {
+			struct page *page = spt_find_page (spt,
+					(uint8_t *) addr + i * PGSIZE);
+			if (page != NULL)
+				spt_remove_page (spt, page);
+		}
+		list_remove (&region->elem);
+		free (region);
+		return;
+	}
+}
+
+/* Copies the mmap_regions in SRC to DST, for fork().  Returns
+ * true if successful, false if out of memory. */
+bool
+mmap_regions_copy (struct list *dst, struct list *src) {
+	struct list_elem *e;
+
+	for (e = list_begin (src); e != list_end (src); e = list_next (e)) {
+		struct mmap_region *region = list_entry (e, struct mmap_region, elem);
+		struct mmap_region *copy = malloc (sizeof *copy);
+
+		if (copy == NULL)
+			return false;
+		copy->addr = region->addr;
+		copy->page_cnt = region->page_cnt;
+		list_push_back (dst, &copy->elem);
+	}
+	return true;
+}
+
+/* Frees the mmap_regions in LIST.  Their pages are freed along
+ * with the supplemental page table. */
+void
+mmap_regions_free (struct list *list) {
+	while (!list_empty (list))
+		free (list_entry (list_pop_front (list), struct mmap_region, elem));
 }
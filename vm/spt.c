@@ -0,0 +1,116 @@
+/* spt.c: Radix tree behind the supplemental page table.
+ *
+ * The tree mirrors the hardware page table: four levels of
+ * page-sized nodes, each holding SPT_FANOUT pointers.  Level 0 is
+ * indexed by PML4(va), level 1 by PDPE(va), level 2 by PDX(va)
+ * and the leaves, at level 3, by PTX(va); leaf slots point to
+ * struct pages. */
+
+#include "vm/vm.h"
+#include <debug.h>
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+
+#define SPT_LEVELS 4                            /* Levels in the tree. */
+#define SPT_FANOUT (PGSIZE / sizeof (void *))   /* Slots per node. */
+
+/* Shift of the index field for each level. */
+static const unsigned spt_shift[SPT_LEVELS] = {
+	PML4SHIFT, PDPESHIFT, PDXSHIFT, PTXSHIFT
+};
+
+/* Returns the index of VA in a node at LEVEL. */
+static inline size_t
+spt_index (uint64_t va, int level) {
+	return (va >> spt_shift[level]) & (SPT_FANOUT - 1);
+}
+
+/* Returns a new, empty node, or NULL if out of memory. */
+static void **
+node_alloc (void) {
+	return palloc_get_page (PAL_ZERO | PAL_VM);
+}
+
+/* Returns the address of the leaf slot for VA in SPT.  If the
+ * path to the slot does not exist, creates it when CREATE is
+ * true and returns NULL otherwise, or if out of memory. */
+void **
+spt_slot (struct supplemental_page_table *spt, const void *va, bool create) {
+	uint64_t addr = (uint64_t) va;
+	void ***link = (void ***) &spt->root;
+	int level;
+
+	for (level = 0; level < SPT_LEVELS; level++) {
+		void **node = *link;
+		if (node == NULL) {
+			if (!create || (node = node_alloc ()) == NULL)
+				return NULL;
+			*link = node;
+		}
+		link = (void ***) &node[spt_index (addr, level)];
+	}
+	return (void **) link;
+}
+
+/* Calls ACTION on each page under NODE, a node at LEVEL covering
+ * addresses from BASE, whose address lies in [START, END).  Pages
+ * are visited in increasing address order. */
+static bool
+walk (void **node, int level, uint64_t base, uint64_t start, uint64_t end,
+		spt_action_func *action, void *aux) {
+	uint64_t span = 1UL << spt_shift[level];
+	size_t i = start > base ? (start - base) / span : 0;
+
+	for (; i < SPT_FANOUT; i++) {
+		uint64_t lo = base + i * span;
+		if (lo >= end)
+			break;
+		if (node[i] == NULL)
+			continue;
+		if (level == SPT_LEVELS - 1) {
+			if (!action (node[i], aux))
+				return false;
+		} else if (!walk (node[i], level + 1, lo, start, end, action, aux))
+			return false;
+	}
+	return true;
+}
+
+/* Calls ACTION with AUX on each page in SPT whose address lies in
+ * [START, END), in increasing address order, skipping empty parts
+ * of the tree.  ACTION may destroy the page it is given but must
+ * not otherwise modify SPT.  Returns false if ACTION stopped the
+ * walk, true otherwise. */
+bool
+spt_for_each (struct supplemental_page_table *spt, void *start, void *end,
+		spt_action_func *action, void *aux) {
+	ASSERT (pg_ofs (start) == 0);
+
+	if (spt->root == NULL || start >= end)
+		return true;
+	return walk (spt->root, 0, 0, (uint64_t) start, (uint64_t) end,
+			action, aux);
+}
+
+/* Frees NODE at LEVEL and every interior node below it. */
+static void
+free_node (void **node, int level) {
+	size_t i;
+
+	if (level < SPT_LEVELS - 1)
+		for (i = 0; i < SPT_FANOUT; i++)
+			if (node[i] != NULL)
+				free_node (node[i], level + 1);
+	palloc_free_page (node);
+}
+
+/* Frees all of SPT's nodes, leaving it empty.  The pages it
+ * pointed to must already have been freed. */
+void
+spt_free_nodes (struct supplemental_page_table *spt) {
+	if (spt->root != NULL)
+		free_node (spt->root, 0);
+	spt->root = NULL;
+	spt->page_cnt = 0;
+}
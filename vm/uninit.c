@@ -9,6 +9,8 @@
  * */
 
 #include "vm/vm.h"
+#include <string.h>
+#include "threads/vaddr.h"
 #include "vm/uninit.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
@@ -50,10 +52,15 @@ uninit_initialize (struct page *page, void *kva) {
 	/* Fetch first, page_initialize may overwrite the values */
 	vm_initializer *init = uninit->init;
 	void *aux = uninit->aux;
+	enum vm_type type = uninit->type;
 
-	/* TODO: You may need to fix this function. */
-	return uninit->page_initializer (page, uninit->type, kva) &&
-		(init ? init (page, aux) : true);
+	if (!uninit->page_initializer (page, uninit->type, kva))
+		return false;
+	if (init != NULL)
+		return init (page, aux);
+	if (VM_TYPE (type) == VM_ANON)
+		memset (kva, 0, PGSIZE);
+	return true;
 }
 
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
@@ -62,7 +69,7 @@ uninit_initialize (struct page *page, void *kva) {
  * PAGE will be freed by the caller. */
 static void
 uninit_destroy (struct page *page) {
-	struct uninit_page *uninit UNUSED = &page->uninit;
-	/* TODO: Fill this function.
-	 * TODO: If you don't have anything to do, just return. */
+	struct uninit_page *uninit = &page->uninit;
+
+	file_load_free (uninit->aux);
 }
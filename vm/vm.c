@@ -1,9 +1,235 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "threads/malloc.h"
+#include <bitmap.h>
+#include <inttypes.h>
+#include <mman.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* Frame table: every frame holding a user page, in clock order.
+ * FRAME_LOCK also serializes eviction against claiming and
+ * freeing frames, so a page is never seen half swapped out.
+ * Eviction writes its victims out with FRAME_LOCK released,
+ * marking them busy meanwhile: a busy frame's pages stay attached
+ * to it, and a thread that needs one of them to settle waits on
+ * FRAME_IO_DONE. */
+static struct list frame_table;
+static struct lock frame_lock;
+static struct condition frame_io_done;
+static struct list_elem *clock_hand;    /* Next frame to examine. */
+
+/* Frame of zeros shared read-only by every anonymous page that has
+ * been read but never written.  It is never on the frame table,
+ * and its reference count includes one for the kernel, so pages
+ * using it are always mapped read-only and a write copies it. */
+static struct frame zero_frame;
+
+/* Text table: frames holding read-only pages of executables,
+ * keyed by inode and offset.  A process that faults on a text
+ * page already resident for another process running the same
+ * program maps that frame instead of reading its own copy.
+ * Protected by FRAME_LOCK. */
+static struct hash text_table;
+
+/* Lowest address the user stack may grow down to. */
+#define STACK_LIMIT (1 << 20)
+
+/* Frames freed by one eviction pass.  Evicting in batches sends
+ * pages evicted together to adjacent swap slots, written back to
+ * back, and lets the next few faults skip eviction entirely. */
+#define EVICT_BATCH 8
+
+/* Pages read together around a read fault in a file-backed
+ * region: the faulting page and its untouched neighbours in the
+ * same aligned window, as one file read into adjacent frames.
+ * Set with -fault-around=PAGES; 1 turns it off. */
+#define FAULT_AROUND_MAX 64
+size_t fault_around_pages = 16;
+
+/* Free user frame watermarks.  Taking a frame when fewer than
+ * WMARK_LOW are free wakes the reclaim daemon, which evicts until
+ * WMARK_HIGH are free.  Only below WMARK_MIN does the faulting
+ * thread evict for itself.  Set with -wmark-min, -wmark-low and
+ * -wmark-high; SIZE_MAX picks a default from the user pool size. */
+size_t wmark_min = SIZE_MAX;
+size_t wmark_low = SIZE_MAX;
+size_t wmark_high = SIZE_MAX;
+
+/* Reclaim daemon, and whether it has been woken but has not yet
+ * finished its pass. */
+static struct semaphore reclaim_sema;
+static bool reclaim_pending;
+
+/* Dirty pages of writable file mappings are written back by the
+ * writeback daemon every WRITEBACK_INTERVAL ticks, so that munmap,
+ * exit and eviction find them clean.  Set with -writeback=TICKS;
+ * 0 leaves them to be written when unmapped or evicted. */
+int64_t writeback_interval = 5 * TIMER_FREQ;
+
+/* Page fault frequency control of resident sets.  Each process's
+ * major faults are counted over windows of at least PFF_WINDOW
+ * ticks.  At the end of a window, a rate above PFF_HIGH faults per
+ * second grows the process's target by a quarter, and a rate
+ * below PFF_LOW shrinks it by an eighth, down to PFF_MIN_TARGET.
+ * A process that stops faulting altogether has its windows closed
+ * by the clock as it passes the process's frames.  New processes
+ * start with an eighth of the user pool. */
+#define PFF_WINDOW (TIMER_FREQ / 10)
+#define PFF_HIGH 200
+#define PFF_LOW 20
+#define PFF_MIN_TARGET 16
+static size_t user_frame_cnt;           /* Frames in the user pool. */
+static size_t rss_over_cnt;             /* Processes above their target. */
+bool rss_report;
+
+/* Frame and swap limits given to processes started by the kernel.
+ * Set with -rss-limit and -swap-limit. */
+size_t rss_limit_default = SIZE_MAX;
+size_t swap_limit_default = SIZE_MAX;
+
+/* Stride prefetching.  Each major fault is compared with the
+ * process's last PF_HISTORY major faults: if it is D pages past
+ * one that is itself D pages past another, for 0 < |D| <=
+ * PF_STRIDE_MAX, it starts a stream with stride D.  If the pages
+ * between the faults are already resident, as after fault-around,
+ * the stream is taken to be sequential.  Starting or continuing a
+ * stream prefetches the next PF_WINDOW pages along it that need
+ * I/O, from swap or from a file, without evicting anything.  The
+ * window doubles each time a fault lands just past it, up to
+ * PF_WINDOW_MAX, and halves each time a prefetched page is
+ * evicted without having been used. */
+#define PF_STRIDE_MAX 16
+#define PF_WINDOW_INIT 4
+#define PF_WINDOW_MAX 32
+
+/* Same-page merging.  When KSM_PAGES is nonzero, the ksmd thread
+ * walks the frame table at the lowest priority, KSM_PAGES frames
+ * every KSM_SLEEP ticks, and checksums each frame that holds only
+ * anonymous pages.  A frame whose checksum is the same as at the
+ * last visit is taken to be stable: if it holds zeros, its pages
+ * are moved to the zero frame; if another stable frame in the
+ * merging table holds the same bytes, its pages are moved there;
+ * otherwise it joins the table.  Merged pages are mapped
+ * read-only and copied on write like pages shared by fork.  Set
+ * with -ksm=PAGES and -ksm-sleep=TICKS, which together bound the
+ * share of the CPU it takes.  Protected by FRAME_LOCK. */
+size_t ksm_pages = 0;
+int64_t ksm_sleep = 20;
+static struct hash ksm_table;
+static struct list_elem *ksm_hand;      /* Next frame to scan. */
+static uint64_t ksm_zero_sum;           /* Checksum of a page of zeros. */
+
+/* Dirty pages collected per writeback batch.  Each batch is
+ * written in order of file and offset, so runs of adjacent pages
+ * reach the disk back to back. */
+#define WRITEBACK_BATCH 64
+
+/* Eviction statistics. */
+static long long evict_clean_file_cnt;  /* Clean file pages dropped. */
+static long long evict_dirty_file_cnt;  /* Dirty file pages written back. */
+static long long evict_anon_cnt;        /* Anonymous pages swapped out. */
+static long long scan_cnt;              /* Frames examined by the clock. */
+static long long scan_max;              /* Longest single scan. */
+
+/* Copy-on-write statistics. */
+static long long cow_share_cnt;         /* Pages shared by fork. */
+static long long cow_copy_cnt;          /* Pages copied on a write fault. */
+static long long cow_reuse_cnt;         /* Write faults on the last sharer. */
+
+/* Zero page statistics. */
+static long long zero_map_cnt;          /* Read faults served by it. */
+static unsigned zero_peak;              /* Most pages using it at once. */
+
+/* Large page statistics. */
+static long long large_map_cnt;         /* 2 MiB pages mapped. */
+
+/* Text sharing statistics. */
+static long long text_share_cnt;        /* Faults served by a shared frame. */
+static unsigned text_saved;             /* Frames saved by sharing now. */
+static unsigned text_peak;              /* ...at most. */
+
+/* Prefetch statistics. */
+static long long prefetch_cnt;          /* Pages brought in early. */
+static long long prefetch_hit_cnt;      /* ...and then used. */
+static long long prefetch_waste_cnt;    /* ...or freed unused. */
+static long long stride_stream_cnt;     /* Streams found. */
+static long long stride_page_cnt;       /* Pages prefetched along them. */
+
+/* Reclaim statistics. */
+static long long reclaim_wake_cnt;      /* Reclaim daemon passes. */
+static long long reclaim_bg_cnt;        /* Pages it evicted. */
+static long long reclaim_direct_cnt;    /* Pages evicted by faulting threads. */
+static long long reclaim_stall_cnt;     /* Faults that had to evict. */
+
+/* Fault statistics, by whether the fault had to do I/O. */
+static long long major_fault_cnt;       /* Read from a file or swap. */
+static long long minor_fault_cnt;       /* Served from memory. */
+static long long fault_around_cnt;      /* Runs of pages read at once. */
+static long long fault_around_page_cnt; /* Pages mapped ahead of use. */
+
+/* madvise() statistics. */
+static long long advise_cnt;            /* Calls. */
+static long long populate_cnt;          /* Pages brought in by it or MAP_POPULATE. */
+static long long discard_cnt;           /* Pages dropped by MADV_DONTNEED. */
+
+/* Operations that unmap pages, for TLB flush statistics. */
+enum unmap_op {
+	UNMAP_MUNMAP,                       /* munmap(). */
+	UNMAP_EXIT,                         /* Process exit or exec. */
+	UNMAP_EVICT,                        /* Eviction batch. */
+	UNMAP_COW,                          /* Copy-on-write break. */
+	UNMAP_OP_CNT
+};
+
+static const char *unmap_op_names[UNMAP_OP_CNT] = {
+	"munmap", "exit", "eviction", "COW break",
+};
+
+/* TLB flush statistics, per operation. */
+static struct {
+	long long op_cnt;                   /* Operations. */
+	long long page_cnt;                 /* Pages they unmapped. */
+	long long flush_cnt;                /* TLB flushes they needed. */
+} unmap_stats[UNMAP_OP_CNT];
+
+/* Writeback statistics. */
+static long long writeback_pass_cnt;    /* Background passes. */
+static long long writeback_page_cnt;    /* Dirty pages written. */
+static long long writeback_run_cnt;     /* ...in this many offset runs. */
+static long long msync_cnt;             /* msync() calls. */
+
+/* Resident set statistics. */
+static long long pff_grow_cnt;          /* Targets raised. */
+static long long pff_shrink_cnt;        /* Targets lowered. */
+static long long evict_over_cnt;        /* Victims from over-target processes. */
+static long long local_reclaim_cnt;     /* Processes evicting their own pages. */
+
+/* Same-page merging statistics. */
+static long long ksm_pass_cnt;          /* Passes. */
+static long long ksm_scan_cnt;          /* Frames scanned. */
+static long long ksm_stable_cnt;        /* ...found unchanged. */
+static long long ksm_merge_cnt;         /* Pages merged into another frame. */
+static long long ksm_zero_cnt;          /* ...of them into the zero frame. */
+
+static hash_hash_func text_hash;
+static hash_less_func text_less;
+static void init_watermarks (void);
+static thread_func reclaim_daemon NO_RETURN;
+static palloc_reclaim_func vm_reclaim;
+static thread_func writeback_daemon NO_RETURN;
+static hash_hash_func ksm_hash;
+static hash_less_func ksm_less;
+static thread_func ksm_daemon NO_RETURN;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -15,7 +241,114 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	list_init (&frame_table);
+	lock_init (&frame_lock);
+	cond_init (&frame_io_done);
+	clock_hand = NULL;
+
+	zero_frame.kva = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_VM);
+	list_init (&zero_frame.pages);
+	zero_frame.ref_cnt = 1;
+	zero_frame.prefetched = false;
+	zero_frame.busy = false;
+	zero_frame.inode = NULL;
+	zero_frame.ksm_listed = false;
+
+	hash_init (&text_table, text_hash, text_less, NULL);
+	hash_init (&ksm_table, ksm_hash, ksm_less, NULL);
+	ksm_hand = NULL;
+	ksm_zero_sum = anon_checksum (zero_frame.kva);
+
+	user_frame_cnt = palloc_free_pages (PAL_USER);
+	init_watermarks ();
+	sema_init (&reclaim_sema, 0);
+	thread_create ("reclaimd", PRI_DEFAULT, reclaim_daemon, NULL);
+	palloc_register_reclaim (vm_reclaim);
+	if (writeback_interval > 0)
+		thread_create ("flushd", PRI_DEFAULT, writeback_daemon, NULL);
+	if (ksm_pages > 0)
+		thread_create ("ksmd", PRI_MIN, ksm_daemon, NULL);
+}
+
+/* Fills in the watermarks not set on the command line and makes
+ * them consistent with each other and with the user pool. */
+static void
+init_watermarks (void) {
+	size_t total = palloc_free_pages (PAL_USER);
+
+	if (wmark_min == SIZE_MAX)
+		wmark_min = total / 64;
+	if (wmark_low == SIZE_MAX)
+		wmark_low = wmark_min * 2;
+	if (wmark_high == SIZE_MAX)
+		wmark_high = wmark_min * 3;
+
+	if (wmark_high > total / 2)
+		wmark_high = total / 2;
+	if (wmark_low > wmark_high)
+		wmark_low = wmark_high;
+	if (wmark_min > wmark_low)
+		wmark_min = wmark_low;
+}
+
+/* Prints eviction statistics. */
+void
+vm_print_stats (void) {
+	long long evict_cnt = evict_clean_file_cnt + evict_dirty_file_cnt
+		+ evict_anon_cnt;
+	int i;
+
+	printf ("VM: %lld evictions (%lld clean file, %lld dirty file, %lld anon)\n",
+			evict_cnt, evict_clean_file_cnt, evict_dirty_file_cnt,
+			evict_anon_cnt);
+	printf ("VM: %lld frames scanned, %lld per eviction, longest scan %lld\n",
+			scan_cnt, evict_cnt > 0 ? scan_cnt / evict_cnt : 0, scan_max);
+	printf ("VM: %lld pages shared by fork, %lld copied on write, "
+			"%lld reused\n", cow_share_cnt, cow_copy_cnt, cow_reuse_cnt);
+	printf ("VM: %lld zero-page maps, %u frames saved now, peak %u\n",
+			zero_map_cnt, zero_frame.ref_cnt - 1, zero_peak);
+	printf ("VM: %lld 2 MiB pages mapped\n", large_map_cnt);
+	printf ("VM: %lld text pages shared, %u frames saved now, peak %u\n",
+			text_share_cnt, text_saved, text_peak);
+	printf ("VM: %lld pages prefetched, %lld used, %lld freed unused, "
+			"%lld%% accurate\n", prefetch_cnt, prefetch_hit_cnt,
+			prefetch_waste_cnt, prefetch_hit_cnt + prefetch_waste_cnt > 0
+			? prefetch_hit_cnt * 100 / (prefetch_hit_cnt + prefetch_waste_cnt)
+			: 0);
+	printf ("VM: %lld stride streams found, %lld pages prefetched along "
+			"them\n", stride_stream_cnt, stride_page_cnt);
+	printf ("VM: %lld batched file reads, %lld extra pages mapped\n",
+			fault_around_cnt, fault_around_page_cnt);
+	printf ("VM: %lld madvise calls, %lld pages populated, %lld discarded\n",
+			advise_cnt, populate_cnt, discard_cnt);
+	printf ("VM: watermarks %zu/%zu/%zu, %lld pages reclaimed in background "
+			"in %lld passes, %lld directly in %lld faults\n",
+			wmark_min, wmark_low, wmark_high, reclaim_bg_cnt, reclaim_wake_cnt,
+			reclaim_direct_cnt, reclaim_stall_cnt);
+	printf ("VM: %lld dirty pages written back in %lld runs, "
+			"%lld background passes, %lld msync calls\n",
+			writeback_page_cnt, writeback_run_cnt, writeback_pass_cnt, msync_cnt);
+	printf ("VM: %lld resident set targets raised, %lld lowered, "
+			"%lld evictions from processes over target, "
+			"%lld local reclaims at a limit\n",
+			pff_grow_cnt, pff_shrink_cnt, evict_over_cnt, local_reclaim_cnt);
+	printf ("VM: %lld same-page merging passes, %lld frames scanned, "
+			"%lld stable, %lld pages merged, %lld into the zero frame\n",
+			ksm_pass_cnt, ksm_scan_cnt, ksm_stable_cnt, ksm_merge_cnt,
+			ksm_zero_cnt);
+	for (i = 0; i < UNMAP_OP_CNT; i++)
+		printf ("VM: %s: %lld TLB flushes for %lld pages in %lld calls\n",
+				unmap_op_names[i], unmap_stats[i].flush_cnt,
+				unmap_stats[i].page_cnt, unmap_stats[i].op_cnt);
+	vm_anon_print_stats ();
+}
+
+/* Stores the number of page faults handled so far that needed
+ * I/O in *MAJOR, and the number that did not in *MINOR. */
+void
+vm_fault_counts (long long *major, long long *minor) {
+	*major = major_fault_cnt;
+	*minor = minor_fault_cnt;
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -33,9 +366,11 @@ page_get_type (struct page *page) {
 }
 
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (struct supplemental_page_table *owner);
 static bool vm_do_claim_page (struct page *page);
-static struct frame *vm_evict_frame (void);
+static bool install_frame (struct page *page, struct frame *frame);
+static struct frame *vm_evict_frame (bool background,
+		struct supplemental_page_table *owner, size_t *cntp);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -48,13 +383,38 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	struct supplemental_page_table *spt = &thread_current ()->spt;
 
-	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+	/* Check wheter the upage is already occupied or not, either by
+	 * a page of SPT or by memory the kernel mapped outside it, such
+	 * as the time page or a ring. */
+	if (is_user_vaddr (upage) && spt_find_page (spt, upage) == NULL
+			&& pml4_get_page (thread_current ()->pml4, upage) == NULL) {
+		bool (*initializer) (struct page *, enum vm_type, void *);
+		struct page *page;
+
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				goto err;
+		}
 
-		/* TODO: Insert the page into the spt. */
+		page = malloc (sizeof *page);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, pg_round_down (upage), init, type, aux, initializer);
+		page->writable = writable;
+		page->pml4 = thread_current ()->pml4;
+		page->advice = MADV_NORMAL;
+
+		if (!spt_insert_page (spt, page)) {
+			free (page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
@@ -62,82 +422,1444 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	void **slot;
 
-	return page;
+	if (!is_user_vaddr (va))
+		return NULL;
+	slot = spt_slot (spt, va, false);
+	return slot != NULL ? *slot : NULL;
 }
 
-/* Insert PAGE into spt with validation. */
+/* Insert PAGE into spt with validation.  Fails if PAGE's address
+ * is already in use or out of memory. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	void **slot;
+
+	ASSERT (pg_ofs (page->va) == 0);
 
-	return succ;
+	if (!is_user_vaddr (page->va))
+		return false;
+	slot = spt_slot (spt, page->va, true);
+	if (slot == NULL || *slot != NULL)
+		return false;
+	*slot = page;
+	page->spt = spt;
+	spt->page_cnt++;
+	return true;
 }
 
+/* Removes PAGE from SPT and frees it. */
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	void **slot = spt_slot (spt, page->va, false);
+
+	ASSERT (slot != NULL && *slot == page);
+	*slot = NULL;
+	spt->page_cnt--;
 	vm_dealloc_page (page);
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+ * wrapping around at the end of the frame table. */
+static struct frame *
+clock_advance (void) {
+	struct frame *frame;
+
+	if (clock_hand == NULL || clock_hand == list_end (&frame_table))
+		clock_hand = list_begin (&frame_table);
+	frame = list_entry (clock_hand, struct frame, elem);
+	clock_hand = list_next (clock_hand);
+	return frame;
+}
+
+/* Puts FRAME on the frame table just behind the clock hand, so
+ * it gets a full revolution before it is considered.  Called
+ * with FRAME_LOCK held. */
+static void
+frame_table_insert (struct frame *frame) {
+	if (clock_hand != NULL)
+		list_insert (clock_hand, &frame->elem);
+	else
+		list_push_back (&frame_table, &frame->elem);
+}
+
+/* Removes FRAME from the frame table, keeping the clock hand
+ * valid, and from the text table if it is there. */
+static void
+frame_table_remove (struct frame *frame) {
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	if (ksm_hand == &frame->elem)
+		ksm_hand = list_next (ksm_hand);
+	list_remove (&frame->elem);
+	if (frame->inode != NULL) {
+		hash_delete (&text_table, &frame->text_elem);
+		frame->inode = NULL;
+	}
+	if (frame->ksm_listed) {
+		hash_delete (&ksm_table, &frame->ksm_elem);
+		frame->ksm_listed = false;
+	}
+}
+
+/* Hashes a text frame by its inode and offset. */
+static uint64_t
+text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *f = hash_entry (e, struct frame, text_elem);
+	return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Orders text frames by inode, then offset. */
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct frame *a = hash_entry (a_, struct frame, text_elem);
+	const struct frame *b = hash_entry (b_, struct frame, text_elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->ofs < b->ofs;
+}
+
+/* If PAGE is read-only program text, whose frame can be shared
+ * with every other mapping of the same part of the same file,
+ * stores its file position in *INODE and *OFS and returns true.
+ * Otherwise returns false.  Only whole pages of the file qualify:
+ * a partial page's contents also depend on how much of it was
+ * read. */
+static bool
+text_key (struct page *page, struct inode **inode, off_t *ofs) {
+	struct file *file;
+	size_t read_bytes;
+
+	if (page->writable)
+		return false;
+	if (page->operations->type == VM_UNINIT
+			&& VM_TYPE (page->uninit.type) == VM_FILE) {
+		const struct file_load *load = page->uninit.aux;
+		file = load->file;
+		*ofs = load->ofs;
+		read_bytes = load->read_bytes;
+	} else if (page->operations->type == VM_FILE) {
+		file = page->file.file;
+		*ofs = page->file.ofs;
+		read_bytes = page->file.read_bytes;
+	} else
+		return false;
+	*inode = file_get_inode (file);
+	return read_bytes == PGSIZE;
+}
+
+/* Returns the frame in the text table holding INODE's page at
+ * OFS, or NULL if none.  Called with FRAME_LOCK held. */
+static struct frame *
+text_lookup (struct inode *inode, off_t ofs) {
+	struct frame key;
+	struct hash_elem *e;
+
+	key.inode = inode;
+	key.ofs = ofs;
+	e = hash_find (&text_table, &key.text_elem);
+	return e != NULL ? hash_entry (e, struct frame, text_elem) : NULL;
+}
+
+/* Enters FRAME, which holds PAGE, into the text table if PAGE is
+ * program text that no other frame holds yet.  Called with
+ * FRAME_LOCK held. */
+static void
+text_register (struct frame *frame, struct page *page) {
+	struct inode *inode;
+	off_t ofs;
+
+	if (!text_key (page, &inode, &ofs) || text_lookup (inode, ofs) != NULL)
+		return;
+	frame->inode = inode;
+	frame->ofs = ofs;
+	hash_insert (&text_table, &frame->text_elem);
+}
+
+/* Returns the first page using FRAME. */
+static struct page *
+frame_page (struct frame *frame) {
+	ASSERT (frame->ref_cnt > 0);
+	return list_entry (list_front (&frame->pages), struct page, frame_elem);
+}
+
+/* Notes whether SPT is above its target.  Called with interrupts
+ * off. */
+static void
+rss_update (struct supplemental_page_table *spt) {
+	bool over = spt->resident > spt->target;
+
+	if (over != spt->over) {
+		spt->over = over;
+		if (over)
+			rss_over_cnt++;
+		else
+			rss_over_cnt--;
+	}
+}
+
+/* Adds DELTA to the resident set of PAGE's process, for PAGE
+ * taking or giving up FRAME.  The zero frame is not counted. */
+static void
+rss_add (struct page *page, struct frame *frame, int delta) {
+	struct supplemental_page_table *spt = page->spt;
+	enum intr_level old_level;
+
+	if (frame == &zero_frame || spt == NULL)
+		return;
+	old_level = intr_disable ();
+	spt->resident += delta;
+	if (spt->resident > spt->resident_peak)
+		spt->resident_peak = spt->resident;
+	rss_update (spt);
+	intr_set_level (old_level);
+}
+
+/* Counts a major fault in SPT if FAULT, and closes SPT's fault
+ * window if it has run long enough, adjusting its target by the
+ * fault rate seen in it. */
+static void
+pff_update (struct supplemental_page_table *spt, bool fault) {
+	enum intr_level old_level = intr_disable ();
+	int64_t elapsed = timer_ticks () - spt->pff_start;
+
+	if (fault)
+		spt->pff_faults++;
+	if (elapsed >= PFF_WINDOW) {
+		spt->pff_rate = spt->pff_faults * TIMER_FREQ / elapsed;
+		if (spt->pff_rate > PFF_HIGH && spt->target < user_frame_cnt) {
+			spt->target += spt->target / 4;
+			if (spt->target > user_frame_cnt)
+				spt->target = user_frame_cnt;
+			pff_grow_cnt++;
+		} else if (spt->pff_rate < PFF_LOW && spt->target > PFF_MIN_TARGET) {
+			spt->target -= spt->target / 8;
+			if (spt->target < PFF_MIN_TARGET)
+				spt->target = PFF_MIN_TARGET;
+			pff_shrink_cnt++;
+		}
+		spt->pff_start += elapsed;
+		spt->pff_faults = 0;
+		rss_update (spt);
+	}
+	intr_set_level (old_level);
+}
+
+/* Adds DELTA to the swap slots charged to PAGE's process. */
+void
+vm_swap_charge (struct page *page, int delta) {
+	enum intr_level old_level;
+
+	if (page->spt == NULL)
+		return;
+	old_level = intr_disable ();
+	page->spt->swap_used += delta;
+	intr_set_level (old_level);
+}
+
+/* Returns true if FRAME may be evicted for OWNER: it is not busy
+ * being written back, OWNER is null or owns every page using
+ * FRAME, and FRAME does not hold anonymous memory of a process at
+ * its swap limit. */
+static bool
+frame_evictable (struct frame *frame, struct supplemental_page_table *owner) {
+	bool anon = frame_page (frame)->operations->type == VM_ANON;
+	struct list_elem *e;
+
+	if (frame->busy)
+		return false;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (owner != NULL && p->spt != owner)
+			return false;
+		if (anon && p->spt != NULL && p->spt->swap_used >= p->spt->swap_limit)
+			return false;
+	}
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Returns true if a process using FRAME is above its target. */
+static bool
+frame_over_target (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (p->spt != NULL) {
+			pff_update (p->spt, false);
+			if (p->spt->over)
+				return true;
+		}
+	}
+	return false;
+}
+
+/* Returns true if PAGE's frame is pinned for I/O.  Called with
+ * FRAME_LOCK held. */
+static bool
+page_busy (struct page *page) {
+	return page->frame != NULL && page->frame->busy;
+}
+
+/* Acquires FRAME_LOCK once PAGE's frame, if any, is not busy.  If
+ * PAGE was being evicted, it no longer has a frame on return. */
+static void
+lock_page_frame (struct page *page) {
+	lock_acquire (&frame_lock);
+	while (page_busy (page))
+		cond_wait (&frame_io_done, &frame_lock);
+}
+
+/* Adds PAGE to the pages using FRAME. */
+static void
+frame_attach (struct frame *frame, struct page *page) {
+	if (frame->inode != NULL && frame->ref_cnt > 0
+			&& ++text_saved > text_peak)
+		text_peak = text_saved;
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->ref_cnt++;
+	page->frame = frame;
+	rss_add (page, frame, 1);
+}
+
+/* Removes PAGE from the pages using FRAME. */
+static void
+frame_detach (struct frame *frame, struct page *page) {
+	if (frame->inode != NULL && frame->ref_cnt > 1)
+		text_saved--;
+	list_remove (&page->frame_elem);
+	frame->ref_cnt--;
+	page->frame = NULL;
+	rss_add (page, frame, -1);
+}
+
+/* Maps PAGE to its frame.  The mapping is writable only if PAGE
+ * is writable and does not share the frame. */
+static bool
+frame_map (struct page *page) {
+	struct frame *frame = page->frame;
+
+	return pml4_set_page (page->pml4, page->va, frame->kva,
+			page->writable && frame->ref_cnt == 1);
+}
+
+/* Returns true if any page using FRAME was accessed since the
+ * last call, and clears their accessed bits. */
+static bool
+frame_test_and_clear_accessed (struct frame *frame) {
+	bool accessed = false;
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+		if (pml4_is_accessed (page->pml4, page->va)) {
+			pml4_set_accessed (page->pml4, page->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Returns true if PAGE can be evicted without any I/O. */
+static bool
+is_clean_file_page (struct page *page) {
+	return page->operations->type == VM_FILE
+		&& !pml4_is_dirty (page->pml4, page->va);
+}
+
+/* Get the struct frame, that will be evicted.
+ *
+ * Second-chance clock over the frame table: a frame whose page
+ * was accessed since the last pass has its accessed bit cleared
+ * and is skipped, unless it was advised MADV_SEQUENTIAL.  Among
+ * the rest, a frame of a process above its resident set target
+ * is taken at once.  So is a clean file-backed page if no process
+ * is above its target, since dropping it costs no I/O.  Otherwise
+ * the first clean file-backed page, or failing that the first
+ * unaccessed frame, is remembered and taken once the hand has
+ * gone all the way around.  If OWNER is nonnull, only frames of
+ * OWNER's alone are considered, and the clock passes the others
+ * by without clearing their accessed bits.  Called with FRAME_LOCK
+ * held. */
 static struct frame *
-vm_get_victim (void) {
+vm_get_victim (struct supplemental_page_table *owner) {
 	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	bool victim_clean = false;
+	size_t frame_cnt = list_size (&frame_table);
+	size_t scanned;
 
+	for (scanned = 0; scanned < 2 * frame_cnt; scanned++) {
+		struct frame *frame;
+		bool accessed, clean;
+
+		if (victim != NULL && scanned >= frame_cnt)
+			break;
+		frame = clock_advance ();
+		if (!frame_evictable (frame, owner))
+			continue;
+		accessed = frame_test_and_clear_accessed (frame);
+		if (accessed && frame->prefetched) {
+			frame->prefetched = false;
+			prefetch_hit_cnt++;
+		}
+		/* Pages read sequentially are used once: no second chance. */
+		if (accessed && frame_page (frame)->advice != MADV_SEQUENTIAL)
+			continue;
+		clean = is_clean_file_page (frame_page (frame));
+		if (frame_over_target (frame)) {
+			victim = frame;
+			evict_over_cnt++;
+			scanned++;
+			break;
+		}
+		if (clean && rss_over_cnt == 0) {
+			victim = frame;
+			scanned++;
+			break;
+		}
+		if (victim == NULL || (clean && !victim_clean)) {
+			victim = frame;
+			victim_clean = clean;
+		}
+	}
+
+	scan_cnt += scanned;
+	if ((long long) scanned > scan_max)
+		scan_max = scanned;
 	return victim;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+/* Returns a new frame for KVA, or NULL if out of memory, in
+ * which case KVA is freed. */
 static struct frame *
-vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+frame_new (void *kva) {
+	struct frame *frame = malloc (sizeof *frame);
+
+	if (frame == NULL) {
+		palloc_free_page (kva);
+		return NULL;
+	}
+	frame->kva = kva;
+	list_init (&frame->pages);
+	frame->ref_cnt = 0;
+	frame->prefetched = false;
+	frame->busy = false;
+	frame->inode = NULL;
+	frame->ksm_sum = 0;
+	frame->ksm_listed = false;
+	return frame;
+}
+
+/* Frees FRAME and its memory. */
+static void
+frame_free (struct frame *frame) {
+	palloc_free_page (frame->kva);
+	free (frame);
+}
+
+/* Flushes the TLB entries gathered in TLB for OP and counts them. */
+static void
+tlb_finish (struct tlb_gather *tlb, enum unmap_op op) {
+	tlb_gather_flush (tlb);
+	unmap_stats[op].op_cnt++;
+	unmap_stats[op].page_cnt += tlb->page_cnt;
+	unmap_stats[op].flush_cnt += tlb->flush_cnt;
+}
+
+/* Unmaps every page using VICTIM, gathering their TLB entries in
+ * TLB, takes VICTIM off the frame table and marks it busy.
+ * Unmapping first makes the owners fault, and wait, rather than
+ * write to the page while it is on its way out.  Called with
+ * FRAME_LOCK held. */
+static void
+evict_unmap (struct frame *victim, struct tlb_gather *tlb) {
+	struct list_elem *e;
+
+	victim->busy = true;
+	for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		pml4_clear_page_gather (p->pml4, p->va, tlb);
+	}
+	frame_table_remove (victim);
+}
+
+/* Writes out the contents of VICTIM, already unmapped by
+ * evict_unmap() and flushed from the TLB.  Called without
+ * FRAME_LOCK: VICTIM being busy keeps its pages attached. */
+static void
+evict (struct frame *victim) {
+	struct page *page = frame_page (victim);
+
+	/* Prefetched for nothing: make the owner prefetch less. */
+	if (victim->prefetched) {
+		prefetch_waste_cnt++;
+		if (page->spt != NULL && page->spt->pf_window > 1)
+			page->spt->pf_window /= 2;
+	}
+
+	if (page->operations->type == VM_FILE) {
+		if (pml4_is_dirty (page->pml4, page->va))
+			evict_dirty_file_cnt++;
+		else
+			evict_clean_file_cnt++;
+	} else
+		evict_anon_cnt++;
+
+	/* Swapping out the first page takes care of every page
+	 * sharing the frame. */
+	if (!swap_out (page))
+		PANIC ("out of swap space");
+}
+
+/* Detaches the pages of VICTIM, written out by evict(), and
+ * unpins it.  Called with FRAME_LOCK held. */
+static void
+evict_finish (struct frame *victim) {
+	while (!list_empty (&victim->pages))
+		frame_detach (victim, frame_page (victim));
+	victim->prefetched = false;
+	victim->busy = false;
+}
+
+/* Evict up to EVICT_BATCH pages, keep the first frame and free the
+ * rest.  Return NULL on error.  The victims are all unmapped
+ * before any is written out, so that one TLB flush covers the
+ * batch.  Evictions are counted as done in the background if
+ * BACKGROUND, otherwise as direct.  Only OWNER's frames are
+ * evicted if OWNER is nonnull.  The number of pages evicted is
+ * stored in *CNTP if CNTP is nonnull.  Called with FRAME_LOCK held,
+ * which is released while the victims are written out. */
+static struct frame *
+vm_evict_frame (bool background, struct supplemental_page_table *owner,
+		size_t *cntp) {
+	struct frame *victims[EVICT_BATCH];
+	struct tlb_gather tlb;
+	size_t cnt, i;
+
+	tlb_gather_init (&tlb);
+	for (cnt = 0; cnt < EVICT_BATCH; cnt++) {
+		victims[cnt] = vm_get_victim (owner);
+		if (victims[cnt] == NULL)
+			break;
+		evict_unmap (victims[cnt], &tlb);
+	}
+	if (cntp != NULL)
+		*cntp = cnt;
+	if (cnt == 0)
+		return NULL;
+	tlb_finish (&tlb, UNMAP_EVICT);
+
+	lock_release (&frame_lock);
+	for (i = 0; i < cnt; i++)
+		evict (victims[i]);
+	lock_acquire (&frame_lock);
+
+	for (i = 0; i < cnt; i++) {
+		evict_finish (victims[i]);
+		if (i > 0)
+			frame_free (victims[i]);
+	}
+	cond_broadcast (&frame_io_done, &frame_lock);
+	if (background)
+		reclaim_bg_cnt += cnt;
+	else
+		reclaim_direct_cnt += cnt;
+	return victims[0];
+}
+
+/* Wakes the reclaim daemon, unless it is already awake. */
+static void
+reclaim_wake (void) {
+	if (!reclaim_pending) {
+		reclaim_pending = true;
+		sema_up (&reclaim_sema);
+	}
+}
+
+/* Reclaim daemon.  Each time it is woken, evicts pages in batches
+ * until WMARK_HIGH frames are free or nothing more can be
+ * evicted, so that faulting threads find free frames waiting. */
+static void
+reclaim_daemon (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&reclaim_sema);
+		reclaim_wake_cnt++;
+		while (palloc_free_pages (PAL_USER) < wmark_high) {
+			struct frame *frame;
+
+			lock_acquire (&frame_lock);
+			frame = vm_evict_frame (true, NULL, NULL);
+			lock_release (&frame_lock);
+			if (frame == NULL)
+				break;
+			frame_free (frame);
+		}
+		reclaim_pending = false;
+	}
+}
+
+/* Reclaim hook for palloc: evicts user frames until PAGE_CNT
+ * have been given back or nothing more can be evicted, and
+ * returns how many were.  User and kernel pages share one pool,
+ * so this serves kernel requests too.  Gives up at once rather
+ * than wait for FRAME_LOCK, since the caller may be in the middle
+ * of an eviction itself. */
+static size_t
+vm_reclaim (enum palloc_flags flags UNUSED, size_t page_cnt) {
+	size_t freed = 0;
+
+	if (lock_held_by_current_thread (&frame_lock)
+			|| !lock_try_acquire (&frame_lock))
+		return 0;
+	while (freed < page_cnt) {
+		size_t cnt;
+		struct frame *frame = vm_evict_frame (true, NULL, &cnt);
+		if (frame == NULL)
+			break;
+		frame_free (frame);
+		freed += cnt;
+	}
+	lock_release (&frame_lock);
+	return freed;
+}
+
+/* A batch of dirty file-backed pages to write back. */
+struct writeback_batch {
+	struct page *pages[WRITEBACK_BATCH];
+	size_t cnt;
+	bool wait;              /* Wait for busy pages instead of skipping? */
+};
+
+/* Adds PAGE to BATCH, a struct writeback_batch, and pins its
+ * frame, if it is a resident page of a writable file mapping that
+ * has been written since it was last cleaned.  A page whose frame
+ * is already busy is skipped, or waited for if BATCH->WAIT: then
+ * it is either clean or evicted, and written, when the wait ends.
+ * Returns false once BATCH is full.  Called with FRAME_LOCK held. */
+static bool
+writeback_add (struct page *page, void *batch_) {
+	struct writeback_batch *batch = batch_;
+
+	while (batch->wait && page_busy (page))
+		cond_wait (&frame_io_done, &frame_lock);
+	if (page->operations->type == VM_FILE && page->writable
+			&& page->frame != NULL && !page->frame->busy
+			&& pml4_is_dirty (page->pml4, page->va)) {
+		page->frame->busy = true;
+		batch->pages[batch->cnt++] = page;
+	}
+	return batch->cnt < WRITEBACK_BATCH;
+}
+
+/* Returns true if page A goes before page B in the file system:
+ * by inode, then by offset. */
+static bool
+writeback_before (struct page *a, struct page *b) {
+	struct inode *ia = file_get_inode (a->file.file);
+	struct inode *ib = file_get_inode (b->file.file);
+
+	return ia != ib ? ia < ib : a->file.ofs < b->file.ofs;
+}
+
+/* Writes back the pages in BATCH in order of file and offset,
+ * leaving them clean but resident.  Called with FRAME_LOCK held,
+ * which is released for the writes: the pages' frames, pinned by
+ * writeback_add(), cannot be evicted or freed meanwhile, while
+ * their owners may keep writing to them. */
+static void
+writeback_flush (struct writeback_batch *batch) {
+	size_t i, j;
+
+	/* Insertion sort: batches are small and mostly in order. */
+	for (i = 1; i < batch->cnt; i++) {
+		struct page *page = batch->pages[i];
+
+		for (j = i; j > 0 && writeback_before (page, batch->pages[j - 1]); j--)
+			batch->pages[j] = batch->pages[j - 1];
+		batch->pages[j] = page;
+	}
+
+	for (i = 0; i < batch->cnt; i++) {
+		struct page *page = batch->pages[i];
+		struct page *prev = i > 0 ? batch->pages[i - 1] : NULL;
+
+		if (prev == NULL
+				|| file_get_inode (prev->file.file)
+					!= file_get_inode (page->file.file)
+				|| prev->file.ofs + PGSIZE != page->file.ofs)
+			writeback_run_cnt++;
+	}
+
+	lock_release (&frame_lock);
+	for (i = 0; i < batch->cnt; i++)
+		swap_out (batch->pages[i]);
+	lock_acquire (&frame_lock);
+
+	for (i = 0; i < batch->cnt; i++)
+		batch->pages[i]->frame->busy = false;
+	if (batch->cnt > 0)
+		cond_broadcast (&frame_io_done, &frame_lock);
+	writeback_page_cnt += batch->cnt;
+}
+
+/* Writes back up to a batch of dirty file-backed pages found on
+ * the frame table.  Returns true if the batch was full, in which
+ * case there may be more. */
+static bool
+writeback_frames (void) {
+	struct writeback_batch batch;
+	struct list_elem *e;
+
+	batch.cnt = 0;
+	batch.wait = false;
+	lock_acquire (&frame_lock);
+	for (e = list_begin (&frame_table); e != list_end (&frame_table);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, elem);
+		if (!writeback_add (frame_page (frame), &batch))
+			break;
+	}
+	writeback_flush (&batch);
+	lock_release (&frame_lock);
+	return batch.cnt == WRITEBACK_BATCH;
+}
+
+/* Writeback daemon.  Every WRITEBACK_INTERVAL ticks, writes back
+ * every dirty page of a file mapping, a batch at a time, letting
+ * faults take FRAME_LOCK between batches. */
+static void
+writeback_daemon (void *aux UNUSED) {
+	for (;;) {
+		thread_sleep (timer_ticks () + writeback_interval);
+		writeback_pass_cnt++;
+		while (writeback_frames ())
+			continue;
+	}
+}
+
+static uint64_t
+ksm_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct frame, ksm_elem)->ksm_sum;
+}
+
+static bool
+ksm_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct frame, ksm_elem)->ksm_sum
+		< hash_entry (b, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Returns true if FRAME holds only anonymous pages, all of them
+ * mapped, so that merging may move them to another frame. */
+static bool
+ksm_mergeable (struct frame *frame) {
+	struct list_elem *e;
+
+	if (frame->inode != NULL)
+		return false;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (p->operations->type != VM_ANON
+				|| pml4_get_page (p->pml4, p->va) == NULL)
+			return false;
+	}
+	return true;
+}
+
+/* Maps every page using FRAME read-only if PROTECT, so that its
+ * contents hold still while they are compared, or else as
+ * frame_map() would. */
+static void
+frame_protect (struct frame *frame, bool protect) {
+	struct list_elem *e;
 
-	return NULL;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (protect)
+			pml4_set_page (p->pml4, p->va, frame->kva, false);
+		else
+			frame_map (p);
+	}
+}
+
+/* Moves the pages using FROM to TO, which holds the same bytes,
+ * mapping them read-only, and frees FROM. */
+static void
+ksm_merge (struct frame *from, struct frame *to) {
+	while (!list_empty (&from->pages)) {
+		struct page *p = frame_page (from);
+
+		frame_detach (from, p);
+		frame_attach (to, p);
+		frame_map (p);
+		ksm_merge_cnt++;
+		if (to == &zero_frame) {
+			ksm_zero_cnt++;
+			if (zero_frame.ref_cnt - 1 > zero_peak)
+				zero_peak = zero_frame.ref_cnt - 1;
+		}
+	}
+	frame_table_remove (from);
+	frame_free (from);
+}
+
+/* Visits FRAME for same-page merging.  Called with FRAME_LOCK
+ * held. */
+static void
+ksm_scan (struct frame *frame) {
+	struct frame *twin = NULL;
+	uint64_t sum;
+
+	ksm_scan_cnt++;
+	if (!ksm_mergeable (frame))
+		return;
+	sum = anon_checksum (frame->kva);
+	if (sum != frame->ksm_sum) {
+		/* Still changing. */
+		if (frame->ksm_listed) {
+			hash_delete (&ksm_table, &frame->ksm_elem);
+			frame->ksm_listed = false;
+		}
+		frame->ksm_sum = sum;
+		return;
+	}
+	if (frame->ksm_listed)
+		return;
+	ksm_stable_cnt++;
+
+	if (sum == ksm_zero_sum)
+		twin = &zero_frame;
+	else {
+		struct hash_elem *e = hash_find (&ksm_table, &frame->ksm_elem);
+		if (e == NULL) {
+			hash_insert (&ksm_table, &frame->ksm_elem);
+			frame->ksm_listed = true;
+			return;
+		}
+		twin = hash_entry (e, struct frame, ksm_elem);
+		if (!ksm_mergeable (twin))
+			return;
+	}
+
+	frame_protect (frame, true);
+	frame_protect (twin, true);
+	if (memcmp (frame->kva, twin->kva, PGSIZE) == 0)
+		ksm_merge (frame, twin);
+	else {
+		frame_protect (frame, false);
+		frame_protect (twin, false);
+	}
+}
+
+/* Same-page merging daemon.  Scans KSM_PAGES frames, one at a
+ * time so that faults can take FRAME_LOCK in between, then sleeps
+ * for KSM_SLEEP ticks. */
+static void
+ksm_daemon (void *aux UNUSED) {
+	for (;;) {
+		size_t i;
+
+		for (i = 0; i < ksm_pages; i++) {
+			lock_acquire (&frame_lock);
+			if (!list_empty (&frame_table)) {
+				if (ksm_hand == NULL || ksm_hand == list_end (&frame_table))
+					ksm_hand = list_begin (&frame_table);
+				struct frame *frame = list_entry (ksm_hand, struct frame, elem);
+				ksm_hand = list_next (ksm_hand);
+				ksm_scan (frame);
+			}
+			lock_release (&frame_lock);
+		}
+		ksm_pass_cnt++;
+		thread_sleep (timer_ticks () + ksm_sleep);
+	}
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.
+ *
+ * A process at its frame limit evicts its own pages first, and
+ * only if it has none it can give up does it go on to the pool.
+ * Below WMARK_LOW free frames the reclaim daemon is woken to
+ * refill the pool in the background; only below WMARK_MIN, or if
+ * the pool is empty, does the caller evict for itself. */
 static struct frame *
 vm_get_frame (void) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
 	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	size_t free_cnt;
+	void *kva;
+
+	if (spt->resident >= spt->rss_limit) {
+		lock_acquire (&frame_lock);
+		frame = vm_evict_frame (false, spt, NULL);
+		lock_release (&frame_lock);
+		if (frame != NULL) {
+			local_reclaim_cnt++;
+			return frame;
+		}
+	}
+
+	free_cnt = palloc_free_pages (PAL_USER);
+	if (free_cnt < wmark_low)
+		reclaim_wake ();
+	if (free_cnt > wmark_min && (kva = palloc_get_page (PAL_USER)) != NULL)
+		frame = frame_new (kva);
+	if (frame == NULL) {
+		lock_acquire (&frame_lock);
+		frame = vm_evict_frame (false, NULL, NULL);
+		lock_release (&frame_lock);
+		reclaim_stall_cnt++;
+	}
+	if (frame == NULL && (kva = palloc_get_page (PAL_USER)) != NULL)
+		frame = frame_new (kva);
 
 	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	ASSERT (frame->ref_cnt == 0);
 	return frame;
 }
 
 /* Growing the stack. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+vm_stack_growth (void *addr) {
+	vm_alloc_page (VM_ANON | VM_STACK, pg_round_down (addr), true);
+}
+
+/* Returns true if a fault at ADDR with user stack pointer RSP
+ * should grow the stack: ADDR is within the stack's limit and at
+ * most 8 bytes below RSP, where PUSH faults. */
+static bool
+is_stack_access (void *addr, uintptr_t rsp) {
+	uintptr_t va = (uintptr_t) addr;
+
+	return rsp != 0 && va < USER_STACK && va >= USER_STACK - STACK_LIMIT
+		&& va + 8 >= rsp;
 }
 
-/* Handle the fault on write_protected page */
+/* Returns the user stack pointer for a fault with frame F: F's own
+ * if USER, else the one saved on entry to the system call that
+ * faulted on the user's behalf.  A kernel thread faulting outside
+ * any system call gets 0, which is never near the stack. */
+static uintptr_t
+fault_rsp (struct intr_frame *f, bool user) {
+	struct intr_frame *user_if = thread_current ()->user_if;
+
+	if (user)
+		return f->rsp;
+	return user_if != NULL ? user_if->rsp : 0;
+}
+
+/* Returns true if PAGE is not resident and would read as all
+ * zeros: it has not been touched yet, or was discarded by
+ * MADV_DONTNEED. */
+static bool
+is_zero_fill (struct page *page) {
+	if (page->operations->type == VM_ANON)
+		return page->frame == NULL && page->anon.slot == BITMAP_ERROR;
+	return page->operations->type == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL;
+}
+
+/* Maps PAGE, which is_zero_fill(), read-only to the zero frame
+ * instead of giving it a frame of its own. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+map_zero_page (struct page *page) {
+	bool success;
+
+	if (page->operations->type == VM_UNINIT)
+		anon_initializer (page, page->uninit.type, NULL);
+
+	lock_acquire (&frame_lock);
+	frame_attach (&zero_frame, page);
+	success = frame_map (page);
+	if (success) {
+		zero_map_cnt++;
+		if (zero_frame.ref_cnt - 1 > zero_peak)
+			zero_peak = zero_frame.ref_cnt - 1;
+	} else
+		frame_detach (&zero_frame, page);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Maps the 2 MiB aligned region around PAGE, which
+ * is_zero_fill(), with one large page, if every page in the region
+ * is writable and is_zero_fill() too.  Each page still gets a
+ * frame of its own, over its 4 kB share of the large page, so the
+ * pages are released one by one as usual: the mmu splits the
+ * large page once one of them is remapped or unmapped.  The
+ * mapping is made only if it leaves WMARK_HIGH frames free and
+ * keeps the process within its frame limit: nothing is evicted to
+ * make room.  Returns true if PAGE was mapped. */
+static bool
+map_large_page (struct page *page) {
+	struct supplemental_page_table *spt = page->spt;
+	uint8_t *base = (uint8_t *) page->va - large_pg_ofs (page->va);
+	uint8_t *kva;
+	size_t i;
+
+	if (!large_pages || spt->resident + LARGE_PGCNT > spt->rss_limit
+			|| palloc_free_pages (PAL_USER) < wmark_high + LARGE_PGCNT)
+		return false;
+	for (i = 0; i < LARGE_PGCNT; i++) {
+		struct page *q = spt_find_page (spt, base + i * PGSIZE);
+		if (q == NULL || !q->writable || !is_zero_fill (q))
+			return false;
+	}
+	kva = palloc_get_large (PAL_USER | PAL_ZERO);
+	if (kva == NULL)
+		return false;
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < LARGE_PGCNT; i++) {
+		struct page *q = spt_find_page (spt, base + i * PGSIZE);
+		struct frame *frame = frame_new (kva + i * PGSIZE);
+
+		if (frame == NULL) {
+			palloc_free_multiple (kva + (i + 1) * PGSIZE, LARGE_PGCNT - i - 1);
+			goto fail;
+		}
+		frame_attach (frame, q);
+	}
+	if (!pml4_set_large_page (page->pml4, base, kva, true))
+		goto fail;
+
+	/* Only now that nothing can fail do the pages stop being
+	 * uninit.  The frames go in the frame table like any other. */
+	for (i = 0; i < LARGE_PGCNT; i++) {
+		struct page *q = spt_find_page (spt, base + i * PGSIZE);
+		anon_initializer (q, q->uninit.type, q->frame->kva);
+		frame_table_insert (q->frame);
+	}
+	large_map_cnt++;
+	lock_release (&frame_lock);
+	return true;
+
+fail:
+	while (i-- > 0) {
+		struct page *q = spt_find_page (spt, base + i * PGSIZE);
+		struct frame *frame = q->frame;
+
+		frame_detach (frame, q);
+		frame_free (frame);
+	}
+	lock_release (&frame_lock);
+	return false;
+}
+
+/* Handle the fault on write_protected page.
+ *
+ * PAGE is writable but shares its frame copy-on-write.  If the
+ * other sharers have gone away, the frame is simply remapped
+ * writable; otherwise PAGE gets a private copy. */
+static bool
+vm_handle_wp (struct page *page) {
+	struct frame *old, *new;
+	struct tlb_gather tlb;
+	bool success;
+
+	lock_page_frame (page);
+	old = page->frame;
+	if (old != NULL && old->ref_cnt == 1) {
+		success = frame_map (page);
+		cow_reuse_cnt++;
+		lock_release (&frame_lock);
+		return success;
+	}
+	lock_release (&frame_lock);
+
+	/* Getting a frame may evict the shared one.  Then PAGE can
+	 * simply be faulted back in, into a frame of its own. */
+	new = vm_get_frame ();
+	lock_page_frame (page);
+	old = page->frame;
+	if (old == NULL) {
+		lock_release (&frame_lock);
+		return install_frame (page, new);
+	}
+	if (old->ref_cnt == 1) {
+		success = frame_map (page);
+		cow_reuse_cnt++;
+		lock_release (&frame_lock);
+		frame_free (new);
+		return success;
+	}
+
+	memcpy (new->kva, old->kva, PGSIZE);
+	frame_detach (old, page);
+	frame_attach (new, page);
+	tlb_gather_init (&tlb);
+	pml4_clear_page_gather (page->pml4, page->va, &tlb);
+	success = frame_map (page);
+	tlb_finish (&tlb, UNMAP_COW);
+	if (!success) {
+		frame_detach (new, page);
+		frame_attach (old, page);
+		frame_map (page);
+		lock_release (&frame_lock);
+		frame_free (new);
+		return false;
+	}
+	frame_table_insert (new);
+	cow_copy_cnt++;
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Returns true if PAGE is untouched and its contents come from a
+ * file, described by the struct file_load in its uninit aux. */
+static bool
+is_file_sourced (struct page *page) {
+	return page->operations->type == VM_UNINIT && page->uninit.aux != NULL;
+}
+
+/* Returns true if Q, which may be NULL, can be read in one piece
+ * with PAGE: both are untouched pages of the same kind, and Q's
+ * contents lie in the same file as PAGE's, as far from them as Q
+ * is from PAGE in memory. */
+static bool
+same_run (struct page *page, struct page *q) {
+	const struct file_load *a = page->uninit.aux;
+	const struct file_load *b;
+
+	if (q == NULL || !is_file_sourced (q)
+			|| q->uninit.type != page->uninit.type
+			|| q->uninit.init != page->uninit.init
+			|| q->writable != page->writable)
+		return false;
+	b = q->uninit.aux;
+	return file_get_inode (b->file) == file_get_inode (a->file)
+		&& b->ofs - a->ofs == (uint8_t *) q->va - (uint8_t *) page->va;
+}
+
+/* Returns the read_bytes of PAGE, which is_file_sourced(). */
+static size_t
+run_bytes (struct page *page) {
+	return ((struct file_load *) page->uninit.aux)->read_bytes;
+}
+
+/* Turns PAGE, which is_file_sourced(), into its real type without
+ * running its initializer's read: its contents are already in the
+ * frame it is attached to. */
+static void
+adopt_loaded (struct page *page) {
+	struct file_load *load = page->uninit.aux;
+
+	if (VM_TYPE (page->uninit.type) == VM_FILE)
+		file_backed_initializer (page, page->uninit.type, NULL);
+	else {
+		anon_initializer (page, page->uninit.type, NULL);
+		file_load_free (load);
+	}
+}
+
+/* Maps PAGE, if it is program text that another process already
+ * has in a frame, to that frame instead of reading it again.
+ * Returns true if successful, false if PAGE is not text or not
+ * resident anywhere. */
+static bool
+share_text_page (struct page *page) {
+	struct inode *inode;
+	struct frame *frame;
+	off_t ofs;
+	bool success = false;
+
+	lock_acquire (&frame_lock);
+	if (text_key (page, &inode, &ofs)
+			&& (frame = text_lookup (inode, ofs)) != NULL) {
+		if (page->operations->type == VM_UNINIT)
+			adopt_loaded (page);
+		frame_attach (frame, page);
+		success = frame_map (page);
+		if (success)
+			text_share_cnt++;
+		else
+			frame_detach (frame, page);
+	}
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Finds the run of pages around PAGE, which is_file_sourced(),
+ * with page numbers in [LO, HI), that continue it in the file,
+ * reads the whole run with one file_read_at() into adjacent free
+ * frames, and maps every page of it.  Nothing is evicted: if the
+ * frames are not free, or the run is just PAGE, returns false and
+ * leaves PAGE to vm_do_claim_page().  Returns true if PAGE was
+ * mapped.  The pages other than PAGE, and PAGE too unless
+ * FAULTING, are marked as prefetched. */
+static bool
+read_run (struct page *page, uint64_t lo, uint64_t hi, bool faulting) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *start, *end, *kva;
+	struct file_load *load;
+	struct page *q;
+	size_t cnt, bytes, i;
+	bool mapped = false;
+
+	/* Every page of the run but the last is read in full. */
+	for (start = page->va; pg_no (start) > lo; start -= PGSIZE) {
+		q = spt_find_page (spt, start - PGSIZE);
+		if (!same_run (page, q) || run_bytes (q) != PGSIZE)
+			break;
+	}
+	for (q = page, end = (uint8_t *) page->va + PGSIZE; pg_no (end) < hi;
+			end += PGSIZE) {
+		struct page *next = spt_find_page (spt, end);
+		if (run_bytes (q) != PGSIZE || !same_run (page, next))
+			break;
+		q = next;
+	}
+	cnt = (end - start) / PGSIZE;
+	if (cnt <= 1 || spt->resident + cnt > spt->rss_limit
+			|| (kva = palloc_get_multiple (PAL_USER, cnt)) == NULL)
+		return false;
+
+	load = spt_find_page (spt, start)->uninit.aux;
+	bytes = (cnt - 1) * PGSIZE + run_bytes (q);
+	if (file_read_at (load->file, kva, bytes, load->ofs) != (off_t) bytes) {
+		palloc_free_multiple (kva, cnt);
+		return false;
+	}
+	memset (kva + bytes, 0, cnt * PGSIZE - bytes);
+
+	/* Each page of the run gets its own frame, unless it is text
+	 * another process already has.  One that cannot be mapped
+	 * stays untouched and is read again if used. */
+	for (i = 0; i < cnt; i++) {
+		struct frame *frame;
+
+		q = spt_find_page (spt, start + i * PGSIZE);
+		if (share_text_page (q)) {
+			palloc_free_page (kva + i * PGSIZE);
+			mapped |= q == page;
+			continue;
+		}
+		if ((frame = frame_new (kva + i * PGSIZE)) == NULL)
+			continue;
+
+		/* Q gets its frame, its type and its place on the frame
+		 * table under one hold of FRAME_LOCK, so no one sees Q
+		 * with a frame that is on no table. */
+		lock_acquire (&frame_lock);
+		frame_attach (frame, q);
+		if (!frame_map (q)) {
+			frame_detach (frame, q);
+			lock_release (&frame_lock);
+			frame_free (frame);
+			continue;
+		}
+		adopt_loaded (q);
+		if (q == page)
+			mapped = true;
+		if (q != page || !faulting) {
+			frame->prefetched = true;
+			prefetch_cnt++;
+			fault_around_page_cnt++;
+		}
+		frame_table_insert (frame);
+		text_register (frame, q);
+		lock_release (&frame_lock);
+	}
+	fault_around_cnt++;
+	return mapped;
+}
+
+/* Handles a read fault on PAGE, which is_file_sourced(), by
+ * reading it together with its neighbours in the fault-around
+ * window.  A page advised MADV_RANDOM is read alone; one advised
+ * MADV_SEQUENTIAL reads the largest window ahead of itself.
+ * Returns true if PAGE was mapped. */
+static bool
+fault_around (struct page *page) {
+	size_t window = fault_around_pages < FAULT_AROUND_MAX
+		? fault_around_pages : FAULT_AROUND_MAX;
+	uint64_t lo;
+
+	if (page->advice == MADV_RANDOM)
+		return false;
+	if (page->advice == MADV_SEQUENTIAL)
+		return read_run (page, pg_no (page->va),
+				pg_no (page->va) + FAULT_AROUND_MAX, true);
+	if (window <= 1)
+		return false;
+	lo = pg_no (page->va) - pg_no (page->va) % window;
+	return read_run (page, lo, lo + window, true);
+}
+
+/* Returns true if bringing PAGE in takes I/O, reading it from its
+ * file or from swap. */
+static bool
+needs_io (struct page *page) {
+	switch (page->operations->type) {
+		case VM_UNINIT:
+			return page->uninit.aux != NULL;
+		case VM_ANON:
+			return page->anon.slot != BITMAP_ERROR;
+		default:
+			return true;
+	}
+}
+
+/* Prefetches the next pages of stream S that need I/O, up to
+ * SPT's window of them, skipping resident pages along the way,
+ * and advances S past them.  Stops early at the end of a region
+ * or when no frame is free. */
+static void
+stream_prefetch (struct supplemental_page_table *spt, struct pf_stream *s) {
+	unsigned fetched = 0, steps;
+
+	for (steps = 0; fetched < spt->pf_window && steps < 2 * PF_WINDOW_MAX;
+			steps++, s->next += s->stride) {
+		void *va = (void *) (s->next << PGBITS);
+		struct page *q;
+
+		if (!is_user_vaddr (va) || (q = spt_find_page (spt, va)) == NULL)
+			break;
+		if (q->frame != NULL || !needs_io (q) || q->advice == MADV_RANDOM)
+			continue;
+		if (!vm_prefetch_page (q))
+			break;
+		fetched++;
+		stride_page_cnt++;
+	}
+}
+
+/* Returns true if every page strictly between page numbers A and
+ * B in SPT is resident. */
+static bool
+gap_resident (struct supplemental_page_table *spt, uint64_t a, uint64_t b) {
+	uint64_t pg;
+
+	if (a > b) {
+		uint64_t t = a;
+		a = b;
+		b = t;
+	}
+	for (pg = a + 1; pg < b; pg++) {
+		struct page *q = spt_find_page (spt, (void *) (pg << PGBITS));
+		if (q == NULL || q->frame == NULL)
+			return false;
+	}
+	return true;
+}
+
+/* Feeds a major fault on PAGE to SPT's stride prefetcher. */
+static void
+stride_fault (struct supplemental_page_table *spt, struct page *page) {
+	uint64_t pg = pg_no (page->va);
+	struct pf_stream *s;
+	unsigned i, j;
+
+	if (page->advice == MADV_RANDOM)
+		return;
+
+	/* Continues a stream? */
+	for (i = 0; i < PF_STREAMS; i++) {
+		s = &spt->pf_streams[i];
+		if (s->stride != 0 && s->next == pg) {
+			if (spt->pf_window < PF_WINDOW_MAX)
+				spt->pf_window *= 2;
+			s->next += s->stride;
+			stream_prefetch (spt, s);
+			return;
+		}
+	}
+
+	/* Starts one? */
+	for (i = 0; i < PF_HISTORY; i++) {
+		uint64_t h = spt->pf_history[i];
+		int64_t d = (int64_t) (pg - h);
+
+		if (h == 0 || d == 0 || d > PF_STRIDE_MAX || d < -PF_STRIDE_MAX)
+			continue;
+		for (j = 0; j < PF_HISTORY; j++)
+			if (spt->pf_history[j] == h - d)
+				break;
+		if (j == PF_HISTORY)
+			continue;
+
+		if ((d > 1 || d < -1) && gap_resident (spt, h, pg))
+			d = d > 0 ? 1 : -1;
+		s = &spt->pf_streams[spt->pf_stream_next++ % PF_STREAMS];
+		s->stride = d;
+		s->next = pg + d;
+		stride_stream_cnt++;
+		stream_prefetch (spt, s);
+		break;
+	}
+	spt->pf_history[spt->pf_head++ % PF_HISTORY] = pg;
 }
 
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page;
+	bool major = false;
+	bool success;
 
-	return vm_do_claim_page (page);
+	if (addr == NULL || !is_user_vaddr (addr))
+		return false;
+	page = spt_find_page (spt, addr);
+	if (page == NULL && is_stack_access (addr, fault_rsp (f, user))) {
+		vm_stack_growth (addr);
+		page = spt_find_page (spt, addr);
+	}
+	if (page == NULL || (write && !page->writable))
+		return false;
+
+	/* A page faulted on while it is being evicted is read back
+	 * in once it is out. */
+	lock_page_frame (page);
+	if (not_present && page->frame != NULL) {
+		/* Resident but unmapped: it was part of a 2 MiB page that
+		 * was unmapped whole when splitting it ran out of memory. */
+		success = frame_map (page);
+		lock_release (&frame_lock);
+		if (success)
+			minor_fault_cnt++;
+		return success;
+	}
+	lock_release (&frame_lock);
+
+	if (!not_present)
+		success = write && vm_handle_wp (page);
+	else if (!write && is_zero_fill (page))
+		success = map_zero_page (page);
+	else if (share_text_page (page))
+		success = true;
+	else {
+		major = needs_io (page);
+		success = (!write && is_file_sourced (page) && fault_around (page))
+			|| (is_zero_fill (page) && map_large_page (page))
+			|| vm_do_claim_page (page);
+	}
+
+	if (success) {
+		if (major)
+			major_fault_cnt++;
+		else
+			minor_fault_cnt++;
+		pff_update (spt, major);
+		if (major)
+			stride_fault (spt, page);
+	}
+	return success;
 }
 
 /* Free the page.
@@ -150,41 +1872,430 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
 
+	if (page == NULL)
+		return false;
 	return vm_do_claim_page (page);
 }
 
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	return install_frame (page, vm_get_frame ());
+}
 
-	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+/* Brings PAGE in ahead of a fault on it, if a frame is free
+ * without evicting anything.  The PTE starts out unaccessed, so
+ * the page stays cold for the clock until it is really used.
+ * Returns true if successful. */
+bool
+vm_prefetch_page (struct page *page) {
+	struct frame *frame;
+	void *kva;
+
+	if (page->frame != NULL || page->spt->resident >= page->spt->rss_limit
+			|| (kva = palloc_get_page (PAL_USER)) == NULL
+			|| (frame = frame_new (kva)) == NULL)
+		return false;
+	frame->prefetched = true;
+	if (!install_frame (page, frame))
+		return false;
+	prefetch_cnt++;
+	return true;
+}
+
+/* Brings in every page from START to END that is not resident,
+ * reading runs of file-backed pages in batches of up to
+ * FAULT_AROUND_MAX pages.  Pages that cannot be read in a batch
+ * are claimed one at a time if MAY_EVICT, and otherwise only if
+ * a frame is free. */
+void
+vm_populate (void *start, void *end, bool may_evict) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *va;
+
+	for (va = start; va < (uint8_t *) end; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+		bool done;
+
+		if (page == NULL || page->frame != NULL)
+			continue;
+		if (is_file_sourced (page)) {
+			uint64_t hi = pg_no (va) + FAULT_AROUND_MAX;
+			if (hi > pg_no (end))
+				hi = pg_no (end);
+			done = read_run (page, pg_no (va), hi, false);
+		} else
+			done = false;
+		if (!done)
+			done = may_evict ? vm_do_claim_page (page) : vm_prefetch_page (page);
+		if (done)
+			populate_cnt++;
+		else if (!may_evict)
+			break;
+	}
+}
+
+/* Drops the contents of PAGE that are in memory, and for an
+ * anonymous page those in swap too, for MADV_DONTNEED.  A
+ * file-backed page is written back first if dirty. */
+static bool
+discard_page (struct page *page, void *aux UNUSED) {
+	switch (page->operations->type) {
+		case VM_ANON:
+			anon_discard (page);
+			break;
+		case VM_FILE:
+			vm_release_frame (page);
+			break;
+		default:
+			return true;
+	}
+	discard_cnt++;
+	return true;
+}
+
+/* Records ADVICE, passed as AUX, on PAGE. */
+static bool
+advise_page (struct page *page, void *aux) {
+	page->advice = *(int *) aux;
+	return true;
+}
+
+/* Applies madvise() ADVICE to the LENGTH bytes at ADDR in the
+ * current process.  MADV_NORMAL, MADV_RANDOM and MADV_SEQUENTIAL
+ * are recorded on each page, for read-ahead and eviction to
+ * consult; MADV_WILLNEED reads the range in now, into free frames
+ * only; MADV_DONTNEED frees it now.  Returns false if ADDR is not
+ * page-aligned, the range is not in user memory or ADVICE is
+ * unknown. */
+bool
+vm_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *end = (uint8_t *) addr + ROUND_UP (length, PGSIZE);
+
+	if (pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| end < (uint8_t *) addr || (uintptr_t) end > KERN_BASE)
+		return false;
+
+	advise_cnt++;
+	switch (advice) {
+		case MADV_NORMAL:
+		case MADV_RANDOM:
+		case MADV_SEQUENTIAL:
+			spt_for_each (spt, addr, end, advise_page, &advice);
+			return true;
+		case MADV_WILLNEED:
+			vm_populate (addr, end, false);
+			return true;
+		case MADV_DONTNEED:
+			spt_for_each (spt, addr, end, discard_page, NULL);
+			return true;
+		default:
+			return false;
+	}
+}
+
+/* Writes back the dirty pages of file mappings among the LENGTH
+ * bytes at ADDR.  With MS_SYNC they are written before returning;
+ * with MS_ASYNC they are left to the writeback daemon.  Returns
+ * false if FLAGS is not one of the two or the range is not page-
+ * aligned user memory that is mapped throughout. */
+bool
+vm_msync (void *addr, size_t length, int flags) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *end = (uint8_t *) addr + ROUND_UP (length, PGSIZE);
+	uint8_t *upage;
+	struct writeback_batch batch;
+
+	if (pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| end < (uint8_t *) addr || (uintptr_t) end > KERN_BASE
+			|| (flags != MS_SYNC && flags != MS_ASYNC))
+		return false;
+	for (upage = addr; upage < end; upage += PGSIZE)
+		if (spt_find_page (spt, upage) == NULL)
+			return false;
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	msync_cnt++;
+	if (flags == MS_ASYNC)
+		return true;
+	upage = addr;
+	batch.wait = true;
+	do {
+		batch.cnt = 0;
+		lock_acquire (&frame_lock);
+		spt_for_each (spt, upage, end, writeback_add, &batch);
+		if (batch.cnt > 0)
+			upage = (uint8_t *) batch.pages[batch.cnt - 1]->va + PGSIZE;
+		writeback_flush (&batch);
+		lock_release (&frame_lock);
+	} while (batch.cnt == WRITEBACK_BATCH);
+	return true;
+}
+
+/* Loads PAGE into FRAME, maps it and puts FRAME on the frame
+ * table.  On failure frees FRAME and returns false.  The attach
+ * and the map are made under FRAME_LOCK, and FRAME is busy while
+ * it is read in without it, so that anyone else who looks at PAGE
+ * meanwhile waits for the load to finish. */
+static bool
+install_frame (struct page *page, struct frame *frame) {
+	bool success;
 
-	return swap_in (page, frame->kva);
+	lock_acquire (&frame_lock);
+	frame->busy = true;
+	frame_attach (frame, page);
+	lock_release (&frame_lock);
+
+	success = swap_in (page, frame->kva);
+
+	lock_acquire (&frame_lock);
+	frame->busy = false;
+	cond_broadcast (&frame_io_done, &frame_lock);
+	if (success && frame_map (page)) {
+		frame_table_insert (frame);
+		text_register (frame, page);
+	} else {
+		frame_detach (frame, page);
+		frame_free (frame);
+		success = false;
+	}
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Unmaps PAGE and drops its use of its frame, if any, freeing
+ * the frame once no page uses it.  A dirty file-backed page is
+ * written back first.  Called by the page types' destroy
+ * functions. */
+void
+vm_release_frame (struct page *page) {
+	struct frame *frame;
+
+	lock_page_frame (page);
+	frame = page->frame;
+	if (frame != NULL) {
+		if (page->operations->type == VM_FILE)
+			swap_out (page);
+		if (frame->prefetched) {
+			if (pml4_is_accessed (page->pml4, page->va))
+				prefetch_hit_cnt++;
+			else
+				prefetch_waste_cnt++;
+		}
+		pml4_clear_page (page->pml4, page->va);
+		frame_detach (frame, page);
+		if (frame->ref_cnt == 0) {
+			frame_table_remove (frame);
+			frame_free (frame);
+		}
+	}
+	lock_release (&frame_lock);
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	spt->root = NULL;
+	spt->page_cnt = 0;
+	list_init (&spt->mmaps);
+	spt->resident = spt->resident_peak = 0;
+	spt->target = user_frame_cnt / 8 > PFF_MIN_TARGET
+		? user_frame_cnt / 8 : PFF_MIN_TARGET;
+	spt->over = false;
+	spt->pff_start = timer_ticks ();
+	spt->pff_faults = 0;
+	spt->pff_rate = 0;
+	spt->rss_limit = rss_limit_default;
+	spt->swap_limit = swap_limit_default;
+	spt->swap_used = 0;
+	memset (spt->pf_history, 0, sizeof spt->pf_history);
+	spt->pf_head = 0;
+	memset (spt->pf_streams, 0, sizeof spt->pf_streams);
+	spt->pf_stream_next = 0;
+	spt->pf_window = PF_WINDOW_INIT;
+}
+
+/* Makes DST, just created by vm_alloc_page(), share SRC's
+ * contents copy-on-write.  SRC is an anonymous page: if it is
+ * resident, both are mapped read-only to its frame, and if it is
+ * in swap, both refer to its swap slot. */
+static bool
+share_page (struct page *dst, struct page *src) {
+	bool success = true;
+
+	/* Skip the uninit stage: DST's contents come from SRC. */
+	anon_initializer (dst, dst->uninit.type, NULL);
+
+	lock_page_frame (src);
+	if (src->frame != NULL) {
+		frame_attach (src->frame, dst);
+		success = frame_map (src) && frame_map (dst);
+		if (success)
+			cow_share_cnt++;
+		else
+			frame_detach (src->frame, dst);
+	} else
+		anon_share_slot (dst, src);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Copies the contents of SRC into DST, bringing either back in
+ * first if it has been evicted.  DST belongs to the current
+ * thread; SRC's owner is blocked in fork(). */
+static bool
+copy_contents (struct page *dst, struct page *src) {
+	for (;;) {
+		lock_acquire (&frame_lock);
+		while (page_busy (src) || page_busy (dst))
+			cond_wait (&frame_io_done, &frame_lock);
+		if (src->frame != NULL && dst->frame != NULL) {
+			memcpy (dst->frame->kva, src->frame->kva, PGSIZE);
+			pml4_set_dirty (dst->pml4, dst->va, true);
+			lock_release (&frame_lock);
+			return true;
+		}
+		lock_release (&frame_lock);
+
+		if ((src->frame == NULL && !vm_do_claim_page (src))
+				|| (dst->frame == NULL && !vm_do_claim_page (dst)))
+			return false;
+	}
+}
+
+/* Copies SRC_PAGE into the current thread's table, which is the
+ * one being filled in by supplemental_page_table_copy(). */
+static bool
+copy_page (struct page *src_page, void *aux UNUSED) {
+	enum vm_type type = src_page->operations->type;
+	void *va = src_page->va;
+	struct file_load *load = NULL;
+	vm_initializer *init = NULL;
+	struct page *dst_page;
+
+	switch (VM_TYPE (type)) {
+		case VM_UNINIT:
+			/* Still untouched: the child loads it on its own. */
+			type = src_page->uninit.type;
+			init = src_page->uninit.init;
+			if (src_page->uninit.aux != NULL
+					&& (load = file_load_dup (src_page->uninit.aux)) == NULL)
+				return false;
+			break;
+		case VM_FILE:
+			/* Reloadable from the file; only a writable copy that
+			 * may have been modified is copied below. */
+			load = file_load_new (src_page->file.file, src_page->file.ofs,
+					src_page->file.read_bytes);
+			if (load == NULL)
+				return false;
+			break;
+		default:
+			break;
+	}
+
+	if (!vm_alloc_page_with_initializer (type, va, src_page->writable,
+				init, load)) {
+		file_load_free (load);
+		return false;
+	}
+	dst_page = spt_find_page (&thread_current ()->spt, va);
+	dst_page->advice = src_page->advice;
+	if (src_page->operations->type == VM_ANON)
+		return share_page (dst_page, src_page);
+	if (src_page->operations->type == VM_FILE && src_page->writable
+			&& src_page->frame != NULL)
+		return copy_contents (dst_page, src_page);
+	return true;
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	ASSERT (dst == &thread_current ()->spt);
+
+	dst->rss_limit = src->rss_limit;
+	dst->swap_limit = src->swap_limit;
+	return spt_for_each (src, NULL, (void *) KERN_BASE, copy_page, NULL)
+		&& mmap_regions_copy (&dst->mmaps, &src->mmaps);
+}
+
+/* Unmaps PAGE if it is resident, gathering its TLB entry in TLB. */
+static bool
+unmap_page (struct page *page, void *tlb) {
+	if (page->frame != NULL)
+		pml4_clear_page_gather (page->pml4, page->va, tlb);
+	return true;
+}
+
+/* Unmaps the resident pages of SPT in [START, END) with one TLB
+ * flush, counted for OP, ahead of destroying them.  Their frames
+ * stay allocated, and their dirty bits are kept for writeback. */
+static void
+unmap_range (struct supplemental_page_table *spt, void *start, void *end,
+		enum unmap_op op) {
+	struct tlb_gather tlb;
+
+	tlb_gather_init (&tlb);
+	lock_acquire (&frame_lock);
+	spt_for_each (spt, start, end, unmap_page, &tlb);
+	tlb_finish (&tlb, op);
+	lock_release (&frame_lock);
+}
+
+/* Unmaps the current process's pages in [START, END), for
+ * munmap(), before they are removed one by one. */
+void
+vm_unmap_range (void *start, void *end) {
+	unmap_range (&thread_current ()->spt, start, end, UNMAP_MUNMAP);
+}
+
+/* Limits the current process to RESIDENT frames and SWAP swap
+ * slots, either of which may be SIZE_MAX for no limit, and evicts
+ * its own pages until it is within the new frame limit or has
+ * nothing left it can evict.  Returns false if RESIDENT is 0. */
+bool
+vm_set_limits (size_t resident, size_t swap) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+
+	if (resident == 0)
+		return false;
+	spt->rss_limit = resident;
+	spt->swap_limit = swap;
+
+	lock_acquire (&frame_lock);
+	while (spt->resident > spt->rss_limit) {
+		struct frame *frame = vm_evict_frame (false, spt, NULL);
+		if (frame == NULL)
+			break;
+		frame_free (frame);
+		local_reclaim_cnt++;
+	}
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Destroys PAGE as part of killing its table. */
+static bool
+kill_page (struct page *page, void *aux UNUSED) {
+	vm_dealloc_page (page);
+	return true;
 }
 
 /* Free the resource hold by the supplemental page table */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	if (rss_report)
+		printf ("%s: resident %zu pages, peak %zu, target %zu, "
+				"%u major faults/s, %zu swap slots\n", thread_name (),
+				spt->resident, spt->resident_peak, spt->target, spt->pff_rate,
+				spt->swap_used);
+	unmap_range (spt, NULL, (void *) KERN_BASE, UNMAP_EXIT);
+	spt_for_each (spt, NULL, (void *) KERN_BASE, kill_page, NULL);
+	spt_free_nodes (spt);
+	mmap_regions_free (&spt->mmaps);
 }
@@ -0,0 +1,244 @@
+/* zswap.c: Compressed cache in front of the swap disk.
+ *
+ * A page swapped out is first compressed and, if that saves at
+ * least half of it, kept in RAM under its swap slot instead of
+ * being written to the disk.  Swapping it back in decompresses it,
+ * which costs far less than reading eight sectors through PIO.
+ * The pool is bounded by zswap_percent of the kernel's free memory
+ * at boot; when a new page does not fit, the oldest pages in the
+ * pool are decompressed and written to their slots on disk.
+ *
+ * Nothing here allocates memory or waits for the disk while
+ * holding ZSWAP_LOCK: malloc() can run the reclaim hooks, which
+ * swap pages out through zswap_store(), and a disk write would
+ * stall every swap-in that hits the pool. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <lz.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Largest compressed page worth keeping. */
+#define ZSWAP_MAX_SIZE (PGSIZE / 2)
+
+/* Bytes of pool charged for a page that compresses to SIZE. */
+#define ENTRY_COST(SIZE) (sizeof (struct zswap_entry) + (SIZE))
+
+/* A compressed page. */
+struct zswap_entry {
+	struct list_elem elem;  /* In LRU, oldest first. */
+	size_t slot;            /* Swap slot the page belongs to. */
+	size_t size;            /* Bytes in DATA. */
+	uint8_t data[];         /* Compressed contents. */
+};
+
+unsigned zswap_percent = 20;
+
+/* Pool state, all protected by ZSWAP_LOCK.  ENTRIES maps each
+ * swap slot to its compressed page, if any.  LZ_WORK is the
+ * compressor's hash table. */
+static struct zswap_entry **entries;
+static struct list lru;
+static size_t pool_bytes, pool_peak, pool_limit;
+static struct lock zswap_lock;
+static void *lz_work;
+
+/* Write-back state.  WRITEBACK_LOCK serializes write-backs, which
+ * run without ZSWAP_LOCK while the disk is busy.  Meanwhile
+ * WB_BUF holds the page being written and WB_SLOT its slot, or
+ * BITMAP_ERROR if there is none; both change only with both locks
+ * held.  WB_DONE is signaled when a write-back finishes. */
+static struct lock writeback_lock;
+static uint8_t *wb_buf;
+static size_t wb_slot = BITMAP_ERROR;
+static struct condition wb_done;
+static zswap_writeback_func *writeback_page;
+
+/* Statistics. */
+static long long store_cnt;             /* Pages stored. */
+static long long reject_cnt;            /* ...not stored, too big or no room. */
+static long long raw_bytes;             /* Bytes of pages stored. */
+static long long comp_bytes;            /* ...after compression. */
+static long long hit_cnt;               /* Swap-ins served from the pool. */
+static long long miss_cnt;              /* Swap-ins read from disk. */
+static long long writeback_cnt;         /* Pages pushed out to disk. */
+
+/* Sets up the pool for SLOT_CNT swap slots, writing pages back to
+ * disk with WRITEBACK. */
+void
+zswap_init (size_t slot_cnt, zswap_writeback_func *writeback) {
+	list_init (&lru);
+	lock_init (&zswap_lock);
+	lock_init (&writeback_lock);
+	cond_init (&wb_done);
+	writeback_page = writeback;
+	pool_limit = palloc_free_pages (0) * zswap_percent / 100 * PGSIZE;
+	if (slot_cnt == 0 || pool_limit == 0)
+		return;
+
+	entries = calloc (slot_cnt, sizeof *entries);
+	lz_work = malloc (LZ_WORK_SIZE);
+	wb_buf = palloc_get_page (PAL_VM);
+	if (entries == NULL || lz_work == NULL || wb_buf == NULL)
+		PANIC ("zswap creation failed");
+}
+
+/* Removes E from the pool and frees it. */
+static void
+entry_free (struct zswap_entry *e) {
+	list_remove (&e->elem);
+	entries[e->slot] = NULL;
+	pool_bytes -= ENTRY_COST (e->size);
+	free (e);
+}
+
+/* Writes the oldest page in the pool, if any, back to disk and
+ * drops it from the pool.  The page leaves the pool before the
+ * write starts; until it is done, zswap_load() serves it from
+ * WB_BUF and zswap_store() waits to reuse its slot. */
+static void
+writeback_oldest (void) {
+	struct zswap_entry *e;
+
+	lock_acquire (&writeback_lock);
+	lock_acquire (&zswap_lock);
+	if (list_empty (&lru)) {
+		lock_release (&zswap_lock);
+		lock_release (&writeback_lock);
+		return;
+	}
+	e = list_entry (list_front (&lru), struct zswap_entry, elem);
+	if (!lz_decompress (e->data, e->size, wb_buf, PGSIZE))
+		PANIC ("zswap: slot %zu is corrupt", e->slot);
+	wb_slot = e->slot;
+	entry_free (e);
+	lock_release (&zswap_lock);
+
+	writeback_page (wb_slot, wb_buf);
+
+	lock_acquire (&zswap_lock);
+	wb_slot = BITMAP_ERROR;
+	writeback_cnt++;
+	cond_broadcast (&wb_done, &zswap_lock);
+	lock_release (&zswap_lock);
+	lock_release (&writeback_lock);
+}
+
+/* Tries to keep the page at KVA, which is being swapped out to
+ * SLOT, in the pool.  Returns true if successful, false if the
+ * caller must write it to disk itself. */
+bool
+zswap_store (size_t slot, const void *kva) {
+	struct zswap_entry *e, *fit;
+	size_t size;
+
+	if (entries == NULL)
+		return false;
+
+	/* Compress into the largest entry we would keep, then trim
+	 * it, both allocations outside ZSWAP_LOCK. */
+	e = malloc (sizeof *e + ZSWAP_MAX_SIZE);
+	lock_acquire (&zswap_lock);
+	while (slot == wb_slot)
+		cond_wait (&wb_done, &zswap_lock);
+	ASSERT (entries[slot] == NULL);
+	size = e != NULL
+		? lz_compress (kva, PGSIZE, e->data, ZSWAP_MAX_SIZE, lz_work) : 0;
+	if (size == 0 || ENTRY_COST (size) > pool_limit) {
+		reject_cnt++;
+		lock_release (&zswap_lock);
+		free (e);
+		return false;
+	}
+	lock_release (&zswap_lock);
+
+	fit = realloc (e, sizeof *e + size);
+	if (fit != NULL)
+		e = fit;
+	e->slot = slot;
+	e->size = size;
+
+	lock_acquire (&zswap_lock);
+	while (pool_bytes + ENTRY_COST (size) > pool_limit) {
+		lock_release (&zswap_lock);
+		writeback_oldest ();
+		lock_acquire (&zswap_lock);
+	}
+	entries[slot] = e;
+	list_push_back (&lru, &e->elem);
+
+	pool_bytes += ENTRY_COST (size);
+	if (pool_bytes > pool_peak)
+		pool_peak = pool_bytes;
+	store_cnt++;
+	raw_bytes += PGSIZE;
+	comp_bytes += size;
+	lock_release (&zswap_lock);
+	return true;
+}
+
+/* Reads the page in SLOT into KVA if the pool has it.  Returns
+ * true if successful, false if the caller must read it from
+ * disk.  The pool keeps the page until the slot is freed. */
+bool
+zswap_load (size_t slot, void *kva) {
+	struct zswap_entry *e;
+	bool hit;
+
+	if (entries == NULL)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	e = entries[slot];
+	if (e != NULL) {
+		if (!lz_decompress (e->data, e->size, kva, PGSIZE))
+			PANIC ("zswap: slot %zu is corrupt", slot);
+		hit = true;
+	} else if (slot == wb_slot) {
+		/* On its way to disk: WB_BUF still has it. */
+		memcpy (kva, wb_buf, PGSIZE);
+		hit = true;
+	} else
+		hit = false;
+	if (hit)
+		hit_cnt++;
+	else
+		miss_cnt++;
+	lock_release (&zswap_lock);
+	return hit;
+}
+
+/* Drops the pool's copy of SLOT, which is being freed, if any. */
+void
+zswap_invalidate (size_t slot) {
+	if (entries == NULL)
+		return;
+
+	lock_acquire (&zswap_lock);
+	if (entries[slot] != NULL)
+		entry_free (entries[slot]);
+	lock_release (&zswap_lock);
+}
+
+/* Prints compressed pool statistics. */
+void
+zswap_print_stats (void) {
+	long long load_cnt = hit_cnt + miss_cnt;
+
+	printf ("Zswap: %lld pages stored at %lld%% of their size, "
+			"%lld rejected, %lld written back\n",
+			store_cnt, raw_bytes > 0 ? comp_bytes * 100 / raw_bytes : 0,
+			reject_cnt, writeback_cnt);
+	printf ("Zswap: %lld of %lld swap-ins hit (%lld%%), "
+			"pool %zu of %zu bytes, peak %zu\n",
+			hit_cnt, load_cnt, load_cnt > 0 ? hit_cnt * 100 / load_cnt : 0,
+			pool_bytes, pool_limit, pool_peak);
+}